@@ -0,0 +1,47 @@
+#pragma once
+
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Static library written by the linker with -archive. All fields are
+/// little endian:
+///   header: "EMUA" | version | member count | symbol count | string table size
+///   members: name | data offset from the start of the file | data size
+///   symbol index: name | index of the member defining it
+///   string table: NUL terminated member and symbol names
+///   member contents, the object files as they were given
+/// The index lists the global symbols defined by each member, the linker
+/// extracts a member only when it defines a symbol that is still undefined.
+constexpr char ARCHIVE_MAGIC[4] = {'E', 'M', 'U', 'A'};
+constexpr uint32_t ARCHIVE_VERSION = 1;
+constexpr std::size_t ARCHIVE_HEADER_SIZE = 20;
+constexpr std::size_t ARCHIVE_MEMBER_SIZE = 12;
+constexpr std::size_t ARCHIVE_SYMBOL_SIZE = 8;
+
+struct ArchiveMember {
+  std::string m_name;
+  const uint8_t* m_data;
+  uint32_t m_size;
+  ArchiveMember(const std::string& a_name, const uint8_t* a_data, uint32_t a_size)
+    : m_name(a_name), m_data(a_data), m_size(a_size) {}
+};
+
+/// Members point into the archive data, m_symbols maps a symbol name to
+/// the index of the member defining it.
+struct ArchiveIndex {
+  std::vector<ArchiveMember> m_members;
+  std::unordered_map<std::string, uint32_t> m_symbols;
+};
+
+void writeArchiveFile(
+  std::ostream& a_out,
+  const std::vector<ArchiveMember>& a_members,
+  const std::vector<std::pair<std::string, uint32_t>>& a_symbols
+);
+
+bool parseArchiveFile(const uint8_t* a_data, std::size_t a_size, ArchiveIndex& a_index);
+
+bool isArchiveData(const uint8_t* a_data, std::size_t a_size);
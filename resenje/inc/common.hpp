@@ -70,6 +70,9 @@ void updateWord(
   uint32_t a_word
 );
 
+SymbolList sortSymbols(SymbolTable& a_sym_tab);
+void sortRelas(std::vector<Rela>& a_relas);
+
 void writeSymTab(std::ostream& a_out, SymbolTable& a_sym_tab);
 void writeRela(
   std::ostream& a_out, 
@@ -83,3 +86,10 @@ void writeSections(
   SymbolTable& a_sym_tab,
   bool a_hex_mode
 );
+
+void writeImage(
+  std::ostream& a_out,
+  SectionDataTable& a_section_data_table,
+  std::vector<std::string>& a_sections,
+  SymbolTable& a_sym_tab
+);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "emulator.hpp"
+#include <string>
+#include <vector>
+
+/// One line of the --batch=<list> file: "<image|snapshot> [key script]".
+/// The key script, or the --input script when the line has none, is typed
+/// on a headless terminal, the output is captured.
+struct BatchRun {
+  std::string m_program_file;
+  std::string m_input_file;
+  bool m_ok = false;
+  std::string m_divergence;
+  uint64_t m_instr_cnt = 0;
+  double m_seconds = 0;
+  std::string m_output;
+  uint32_t m_gpr[GPR_NUM] = {};
+};
+
+struct BatchConfig {
+  std::string m_list_file;
+  /// When set the captured output of run N is written to <dir>/N.out.
+  std::string m_output_dir;
+  std::size_t m_jobs = 0;
+  TimerState m_timer;
+  bool m_idle = true;
+  std::string m_input_file;
+  /// Snapshot and trace files of run N get the suffix ".N".
+  SnapshotState m_snapshot;
+  bool m_trace_recording = false;
+  bool m_trace_replaying = false;
+  std::string m_trace_file;
+};
+
+int32_t runBatch(const BatchConfig& a_config);
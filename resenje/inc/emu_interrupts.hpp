@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+/// Values the cause CSR takes on entry to the handler.
+constexpr uint32_t CAUSE_TIMER = 0x00000002;
+constexpr uint32_t CAUSE_TERMINAL = 0x00000003;
+constexpr uint32_t CAUSE_SOFTWARE = 0x00000004;
+constexpr uint32_t CAUSE_DMA = 0x00000005;
+
+/// Hardware interrupt lines from the highest priority down.
+constexpr uint32_t IRQ_PRIORITY[] = {CAUSE_TERMINAL, CAUSE_TIMER, CAUSE_DMA};
+
+/// Devices latch requests into m_pending, one bit per cause, and a request
+/// stays there until the guest can take it, so nothing is lost while
+/// interrupts are masked.
+struct InterruptController {
+  uint32_t m_pending = 0;
+};
+
+inline uint32_t irqBit(uint32_t a_cause) {
+  return 1u << a_cause;
+}
+
+inline void requestIrq(InterruptController& a_irq, uint32_t a_cause) {
+  a_irq.m_pending|= irqBit(a_cause);
+}
+
+/// Whether a_cause is one of the hardware interrupt lines.
+inline bool isIrqCause(uint32_t a_cause) {
+  for (uint32_t cause : IRQ_PRIORITY) {
+    if (cause == a_cause) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline bool irqPending(const InterruptController& a_irq, uint32_t a_cause) {
+  return (a_irq.m_pending & irqBit(a_cause)) != 0;
+}
+
+/// Highest priority cause among a_ready, which must not be empty.
+inline uint32_t takeIrq(InterruptController& a_irq, uint32_t a_ready) {
+  for (uint32_t cause : IRQ_PRIORITY) {
+    if ((a_ready & irqBit(cause)) != 0) {
+      a_irq.m_pending&= ~irqBit(cause);
+      return cause;
+    }
+  }
+  return 0;
+}
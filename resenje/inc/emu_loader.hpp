@@ -0,0 +1,6 @@
+#pragma once
+
+#include "emu_memory.hpp"
+#include <string>
+
+int32_t loadProgram(GuestMemory& a_mem, const std::string& a_input_file);
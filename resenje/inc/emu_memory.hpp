@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+/// Guest memory is a two level page table: the upper 10 address bits select
+/// a page table, the next 10 bits select a 4 KiB page inside it. Tables and
+/// pages are allocated on first write, unwritten memory reads as zero.
+/// Pages restored from a snapshot point into a private mapping of the
+/// snapshot file, the kernel copies them on the first write.
+constexpr uint32_t PAGE_BITS = 12;
+constexpr uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+constexpr uint32_t PAGE_OFFSET_MASK = PAGE_SIZE - 1;
+constexpr uint32_t PAGE_TABLE_BITS = 10;
+constexpr uint32_t PAGE_TABLE_SIZE = 1u << PAGE_TABLE_BITS;
+constexpr uint32_t PAGE_DIR_SIZE = 1u << (32 - PAGE_BITS - PAGE_TABLE_BITS);
+
+using Page = std::array<uint8_t, PAGE_SIZE>;
+using PageTable = std::array<Page*, PAGE_TABLE_SIZE>;
+
+struct GuestMemory {
+  std::array<std::unique_ptr<PageTable>, PAGE_DIR_SIZE> m_page_dir;
+  std::vector<std::unique_ptr<Page>> m_owned_pages;
+  void* m_mapping = nullptr;
+  std::size_t m_mapping_size = 0;
+
+  ~GuestMemory();
+};
+
+inline uint32_t pageDirIndex(uint32_t a_addr) {
+  return a_addr >> (PAGE_BITS + PAGE_TABLE_BITS);
+}
+
+inline uint32_t pageTableIndex(uint32_t a_addr) {
+  return (a_addr >> PAGE_BITS) & (PAGE_TABLE_SIZE - 1);
+}
+
+/// Returns the page holding a_addr or nullptr if it was never written.
+inline uint8_t* findPage(const GuestMemory& a_mem, uint32_t a_addr) {
+  const PageTable* table = a_mem.m_page_dir[pageDirIndex(a_addr)].get();
+  if (table == nullptr) {
+    return nullptr;
+  }
+  Page* page = (*table)[pageTableIndex(a_addr)];
+  return page == nullptr ? nullptr : page->data();
+}
+
+uint8_t* allocPage(GuestMemory& a_mem, uint32_t a_addr);
+void mapPage(GuestMemory& a_mem, uint32_t a_addr, Page* a_page);
+
+/// Calls a_fn(page address, page) for every allocated page in address order.
+template <typename F>
+void forEachPage(const GuestMemory& a_mem, F a_fn) {
+  for (uint32_t dir = 0; dir < PAGE_DIR_SIZE; dir++) {
+    if (a_mem.m_page_dir[dir] == nullptr) {
+      continue;
+    }
+    for (uint32_t table = 0; table < PAGE_TABLE_SIZE; table++) {
+      const Page* page = (*a_mem.m_page_dir[dir])[table];
+      if (page != nullptr) {
+        a_fn((dir << (PAGE_BITS + PAGE_TABLE_BITS)) | (table << PAGE_BITS), *page);
+      }
+    }
+  }
+}
+
+/// Returns the page holding a_addr, allocating it if needed.
+inline uint8_t* touchPage(GuestMemory& a_mem, uint32_t a_addr) {
+  uint8_t* page = findPage(a_mem, a_addr);
+  return page != nullptr ? page : allocPage(a_mem, a_addr);
+}
+
+inline uint8_t memReadByte(const GuestMemory& a_mem, uint32_t a_addr) {
+  const uint8_t* page = findPage(a_mem, a_addr);
+  return page == nullptr ? 0x00 : page[a_addr & PAGE_OFFSET_MASK];
+}
+
+inline void memWriteByte(GuestMemory& a_mem, uint32_t a_addr, uint8_t a_byte) {
+  touchPage(a_mem, a_addr)[a_addr & PAGE_OFFSET_MASK] = a_byte;
+}
+
+uint32_t memReadWordSlow(const GuestMemory& a_mem, uint32_t a_addr);
+uint32_t memReadInstrSlow(const GuestMemory& a_mem, uint32_t a_addr);
+void memWriteWordSlow(GuestMemory& a_mem, uint32_t a_addr, uint32_t a_word);
+void memWriteBlock(GuestMemory& a_mem, uint32_t a_addr, const uint8_t* a_src, std::size_t a_len);
+/// Bulk guest to guest copy with memmove semantics and bulk fill, done a
+/// page sized chunk at a time. Ranges must not wrap around the address space.
+void memCopy(GuestMemory& a_mem, uint32_t a_dst, uint32_t a_src, uint32_t a_len);
+void memFill(GuestMemory& a_mem, uint32_t a_dst, uint8_t a_byte, uint32_t a_len);
+
+inline bool wordInsidePage(uint32_t a_addr) {
+  return (a_addr & PAGE_OFFSET_MASK) <= PAGE_SIZE - 4;
+}
+
+/// Data words are little endian.
+inline uint32_t memReadWord(const GuestMemory& a_mem, uint32_t a_addr) {
+  if (!wordInsidePage(a_addr)) {
+    return memReadWordSlow(a_mem, a_addr);
+  }
+  const uint8_t* page = findPage(a_mem, a_addr);
+  if (page == nullptr) {
+    return 0x00000000;
+  }
+  const uint8_t* p = page + (a_addr & PAGE_OFFSET_MASK);
+  return static_cast<uint32_t>(p[0]) |
+    (static_cast<uint32_t>(p[1]) << 8) |
+    (static_cast<uint32_t>(p[2]) << 16) |
+    (static_cast<uint32_t>(p[3]) << 24);
+}
+
+/// Instructions are stored with the opcode byte first (big endian).
+inline uint32_t memReadInstr(const GuestMemory& a_mem, uint32_t a_addr) {
+  if (!wordInsidePage(a_addr)) {
+    return memReadInstrSlow(a_mem, a_addr);
+  }
+  const uint8_t* page = findPage(a_mem, a_addr);
+  if (page == nullptr) {
+    return 0x00000000;
+  }
+  const uint8_t* p = page + (a_addr & PAGE_OFFSET_MASK);
+  return (static_cast<uint32_t>(p[0]) << 24) |
+    (static_cast<uint32_t>(p[1]) << 16) |
+    (static_cast<uint32_t>(p[2]) << 8) |
+    static_cast<uint32_t>(p[3]);
+}
+
+inline void memWriteWord(GuestMemory& a_mem, uint32_t a_addr, uint32_t a_word) {
+  if (!wordInsidePage(a_addr)) {
+    memWriteWordSlow(a_mem, a_addr, a_word);
+    return;
+  }
+  uint8_t* p = touchPage(a_mem, a_addr) + (a_addr & PAGE_OFFSET_MASK);
+  p[0] = static_cast<uint8_t>(a_word & 0xFF);
+  p[1] = static_cast<uint8_t>((a_word >> 8) & 0xFF);
+  p[2] = static_cast<uint8_t>((a_word >> 16) & 0xFF);
+  p[3] = static_cast<uint8_t>((a_word >> 24) & 0xFF);
+}
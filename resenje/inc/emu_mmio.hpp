@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/// The top 256 bytes of the address space belong to devices. Each word
+/// sized register slot holds the handlers of the device mapped there, an
+/// unmapped slot reads as zero and ignores writes.
+constexpr uint32_t MMIO_BASE = 0xFFFFFF00;
+constexpr uint32_t MMIO_SLOT_NUM = (0xFFFFFFFF - MMIO_BASE + 1) / 4;
+
+using MmioReadHandler = uint32_t (*)(uint32_t a_addr);
+using MmioWriteHandler = void (*)(uint32_t a_addr, uint32_t a_val);
+
+struct MmioSlot {
+  MmioReadHandler m_read;
+  MmioWriteHandler m_write;
+};
+
+inline bool isMmioAddr(uint32_t a_addr) {
+  return a_addr >= MMIO_BASE;
+}
+
+void registerMmioDevice(
+  uint32_t a_base, 
+  uint32_t a_size, 
+  MmioReadHandler a_read, 
+  MmioWriteHandler a_write
+);
+uint32_t mmioRead(uint32_t a_addr);
+void mmioWrite(uint32_t a_addr, uint32_t a_val);
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+constexpr uint64_t DEFAULT_PROFILE_INTERVAL = 1000;
+
+/// Sampling profiler behind --profile: the pc of every m_interval-th
+/// retired instruction is counted in m_samples.
+struct Profiler {
+  bool m_enabled = false;
+  uint64_t m_interval = DEFAULT_PROFILE_INTERVAL;
+  uint64_t m_countdown = DEFAULT_PROFILE_INTERVAL;
+  std::unordered_map<uint32_t, uint64_t> m_samples;
+  std::string m_symtab_file;
+  std::string m_folded_file;
+};
+
+inline void profileInstr(Profiler& a_profiler, uint32_t a_pc) {
+  if (--a_profiler.m_countdown == 0) {
+    a_profiler.m_countdown = a_profiler.m_interval;
+    a_profiler.m_samples[a_pc]++;
+  }
+}
+
+struct SymbolEntry {
+  uint32_t m_addr;
+  std::string m_name;
+  std::string m_sctn_name;
+};
+
+/// Sections and labels of a linked program sorted by address, read from the
+/// #.symtab the linker writes with -symtab=<file>.
+struct SymbolMap {
+  std::vector<SymbolEntry> m_sections;
+  std::vector<SymbolEntry> m_labels;
+};
+
+/// Shadow call stack behind --callgraph. Calls and interrupts push a frame
+/// keyed by the stack slot of their return address, returns pop frames down
+/// to the one whose slot they read, so unbalanced guest code resyncs.
+constexpr std::size_t MAX_SHADOW_DEPTH = 4096;
+
+struct ShadowFrame {
+  uint32_t m_func;
+  uint32_t m_ret_slot;
+  uint64_t m_enter_instr;
+  uint64_t m_child_instrs;
+};
+
+struct FuncProfile {
+  uint64_t m_calls = 0;
+  uint64_t m_inclusive = 0;
+  uint64_t m_exclusive = 0;
+};
+
+/// m_active counts the open activations of the caller to callee pair, only
+/// the outermost one adds its instructions.
+struct CallEdge {
+  uint64_t m_calls = 0;
+  uint64_t m_instrs = 0;
+  uint32_t m_active = 0;
+};
+
+struct CallGraph {
+  bool m_enabled = false;
+  bool m_entry_pending = false;
+  uint32_t m_pending_slot = 0;
+  /// Frames deeper than MAX_SHADOW_DEPTH are only counted, their
+  /// instructions go to the deepest tracked frame.
+  uint64_t m_untracked_depth = 0;
+  uint64_t m_untracked_calls = 0;
+  std::vector<ShadowFrame> m_stack;
+  std::unordered_map<uint32_t, uint32_t> m_active;
+  std::unordered_map<uint32_t, FuncProfile> m_funcs;
+  std::unordered_map<uint64_t, CallEdge> m_edges;
+};
+
+void callGraphCall(CallGraph& a_graph, uint32_t a_ret_slot);
+void callGraphEnter(CallGraph& a_graph, uint32_t a_func, uint64_t a_enter_instr);
+void callGraphReturn(CallGraph& a_graph, uint32_t a_ret_slot, uint64_t a_instr_cnt);
+void finishCallGraph(CallGraph& a_graph, uint64_t a_instr_cnt);
+
+bool loadSymbolMap(const std::string& a_symtab_file, SymbolMap& a_map);
+std::string symbolize(const SymbolMap& a_map, uint32_t a_addr);
+int32_t showProfile(const Profiler& a_profiler);
+int32_t showCallGraph(const CallGraph& a_graph, const std::string& a_symtab_file);
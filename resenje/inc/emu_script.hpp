@@ -0,0 +1,39 @@
+#pragma once
+
+#include <charconv>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Numbers in options and key scripts are unsigned, decimal or hexadecimal
+/// with a 0x prefix. Signs are rejected.
+template<typename T>
+bool parseOptionNumber(std::string_view a_text, T& a_value) {
+  if (a_text.empty() || a_text[0] == '-' || a_text[0] == '+') {
+    return false;
+  }
+  int base = 10;
+  if (a_text.size() > 2 && a_text[0] == '0' && (a_text[1] == 'x' || a_text[1] == 'X')) {
+    a_text.remove_prefix(2);
+    base = 16;
+  }
+  auto result = std::from_chars(a_text.data(), a_text.data() + a_text.size(), a_value, base);
+  return !a_text.empty() && result.ec == std::errc() && result.ptr == a_text.data() + a_text.size();
+}
+
+/// A key typed on the headless terminal once m_instr_cnt instructions
+/// have retired.
+struct KeyEvent {
+  uint64_t m_instr_cnt;
+  char m_key;
+};
+
+/// Key script, one "<instruction count> <keys>" pair per line, '#' starts
+/// a comment line. The keys of a line are typed one after another starting
+/// at the given count, each as soon as the guest can take the interrupt.
+/// Keys may use the escapes \n \r \t \s (space) \\ and \xHH. Counts must
+/// not decrease from line to line.
+bool parseKeyScript(const std::string& a_text, std::vector<KeyEvent>& a_keys);
+bool loadKeyScript(const std::string& a_file, std::vector<KeyEvent>& a_keys);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "emulator.hpp"
+#include <string>
+
+/// Snapshot file written by --snapshot=<file> and read by --restore=<file>:
+///   header: "EMUS" | version | page count | registers | device state
+///   page address table, padded to PAGE_SIZE
+///   page contents, PAGE_SIZE bytes each in table order
+/// Page contents are page aligned so a restore maps the file privately and
+/// uses it as guest memory without copying. A restore keeps the timer mode
+/// of the snapshot, so -vtime is only accepted when it matches it, and the
+/// headless key script resumes at the saved key.
+constexpr char SNAPSHOT_MAGIC[4] = {'E', 'M', 'U', 'S'};
+constexpr uint32_t SNAPSHOT_VERSION = 4;
+
+bool saveSnapshot(const Emulator& a_emulator, const std::string& a_file);
+bool restoreSnapshot(Emulator& a_emulator, const std::string& a_file);
+bool isSnapshotFile(const std::string& a_file);
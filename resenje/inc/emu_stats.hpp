@@ -0,0 +1,31 @@
+#pragma once
+
+#include <array>
+#include <stdint.h>
+#include <stdlib.h>
+
+/// Histograms are indexed by (oc << 4) | mod.
+constexpr std::size_t INSTR_KIND_NUM = 256;
+constexpr std::size_t CAUSE_NUM = 6;
+
+/// Counters behind --stats. The dispatch loops are instantiated with and
+/// without counting, so a run without --stats never touches the instruction
+/// histograms. Interrupts and MMIO accesses are counted unconditionally where
+/// they are raised or dispatched, off the plain memory path.
+/// Loads and stores are derived from the histogram when the report is made.
+struct EmulatorStats {
+  bool m_enabled = false;
+  bool m_json = false;
+  std::array<uint64_t, INSTR_KIND_NUM> m_instr_hist{};
+  std::array<uint64_t, INSTR_KIND_NUM> m_taken_hist{};
+  std::array<uint64_t, CAUSE_NUM> m_interrupts{};
+  uint64_t m_mmio_reads = 0;
+  uint64_t m_mmio_writes = 0;
+};
+
+void showStats(
+  const EmulatorStats& a_stats, 
+  const char* a_engine, 
+  uint64_t a_instr_cnt, 
+  double a_seconds
+);
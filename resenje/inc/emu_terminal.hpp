@@ -1,3 +1,15 @@
 #pragma once
 
+#include <chrono>
+#include <string>
+
 void initTerminal();
+void startTerminalReader();
+void stopTerminalReader();
+bool readTerminalChar(char& a_c);
+/// Blocks until input is queued or a_deadline passes.
+bool waitTerminalInput(std::chrono::steady_clock::time_point a_deadline);
+bool openTerminalOutput(const std::string& a_output_file);
+void writeTerminalChar(char a_c);
+void flushTerminalOutput();
+void flushTerminalOutputIfDue();
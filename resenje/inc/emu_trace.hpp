@@ -0,0 +1,123 @@
+#pragma once
+
+#include "spsc_queue.hpp"
+
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <memory>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Execution trace written with --trace=<file> and checked by --replay=<file>.
+/// After the header ("EMUT", version word) the file is a stream of records,
+/// each starting with a tag byte:
+///   instruction: TRACE_INSTR | flags, pc delta against the sequential pc
+///     (zigzag varint), instruction word on a word cache miss, changed
+///     registers (count, then index and varint value) and memory writes
+///     (count, then address and value words)
+///   interrupt: TRACE_INTERRUPT, cause, term_in word, varint instruction count
+///   end: TRACE_END, varint instruction count
+/// An instruction record is written once the next instruction starts, so its
+/// register writes are the difference between the two register files.
+constexpr char TRACE_MAGIC[4] = {'E', 'M', 'U', 'T'};
+constexpr uint32_t TRACE_VERSION = 1;
+constexpr std::size_t TRACE_HEADER_SIZE = 8;
+
+constexpr uint8_t TRACE_INSTR = 0x00;
+constexpr uint8_t TRACE_PC_JUMP = 0x01;
+constexpr uint8_t TRACE_INSTR_WORD = 0x02;
+constexpr uint8_t TRACE_REG_WRITES = 0x04;
+constexpr uint8_t TRACE_MEM_WRITES = 0x08;
+constexpr uint8_t TRACE_INTERRUPT = 0x40;
+constexpr uint8_t TRACE_END = 0x80;
+
+/// Register file as seen by the trace: r0..r15 followed by the csrs. The pc
+/// slot is never compared, the instruction records carry it.
+constexpr std::size_t TRACE_REG_NUM = 19;
+constexpr std::size_t TRACE_PC_REG = 15;
+constexpr std::size_t TRACE_MAX_MEM_WRITES = 2;
+constexpr std::size_t TRACE_WORD_CACHE_SIZE = 4096;
+
+using TraceRegs = std::array<uint32_t, TRACE_REG_NUM>;
+
+struct TraceMemWrite {
+  uint32_t m_addr;
+  uint32_t m_val;
+};
+
+/// What an instruction does that can be known before it executes.
+struct TraceInstr {
+  uint32_t m_pc = 0;
+  uint32_t m_word = 0;
+  uint8_t m_mem_write_cnt = 0;
+  std::array<TraceMemWrite, TRACE_MAX_MEM_WRITES> m_mem_writes;
+};
+
+struct TraceEvent {
+  uint8_t m_cause;
+  uint32_t m_term_in;
+  uint64_t m_instr_cnt;
+};
+
+/// Delta state shared by the writer and the replayer, both sides update it
+/// the same way record by record.
+struct TraceCursor {
+  uint32_t m_next_pc = 0x40000000;
+  TraceRegs m_regs{};
+  std::array<uint32_t, TRACE_WORD_CACHE_SIZE> m_word_pcs{};
+  std::array<uint32_t, TRACE_WORD_CACHE_SIZE> m_words{};
+  std::bitset<TRACE_WORD_CACHE_SIZE> m_word_valid;
+};
+
+/// Records are appended to the current chunk by the emulator thread. Full
+/// chunks go through a ring of TRACE_CHUNK_NUM buffers to the writer thread,
+/// which hands them to the kernel and returns them empty. The emulator only
+/// waits when every chunk is queued for writing.
+using TraceChunk = std::vector<uint8_t>;
+
+constexpr std::size_t TRACE_CHUNK_SIZE = 1 << 16;
+constexpr std::size_t TRACE_CHUNK_NUM = 16;
+
+struct TraceWriter {
+  std::vector<std::unique_ptr<TraceChunk>> m_chunks;
+  SpscQueue<TraceChunk*, TRACE_CHUNK_NUM + 1> m_full_chunks;
+  SpscQueue<TraceChunk*, TRACE_CHUNK_NUM + 1> m_free_chunks;
+  TraceChunk* m_chunk = nullptr;
+  int m_fd = -1;
+  /// Set by the writer thread when a write fails, the chunks after it are
+  /// dropped. Read once the thread is joined.
+  bool m_failed = false;
+  std::atomic<bool> m_running{false};
+  std::thread m_thread;
+};
+
+struct TraceState {
+  bool m_recording = false;
+  bool m_replaying = false;
+  std::string m_file;
+  TraceCursor m_cursor;
+  bool m_pending = false;
+  TraceInstr m_instr;
+  TraceWriter m_writer;
+
+  std::vector<uint8_t> m_data;
+  std::size_t m_pos = 0;
+  std::vector<TraceEvent> m_events;
+  std::size_t m_next_event = 0;
+  bool m_diverged = false;
+  std::string m_divergence;
+};
+
+bool startTraceWriter(TraceState& a_trace);
+void traceInstr(TraceState& a_trace, const TraceRegs& a_regs);
+void traceInterrupt(TraceState& a_trace, const TraceEvent& a_event);
+/// False when any part of the trace could not be written.
+bool stopTraceWriter(TraceState& a_trace, uint64_t a_instr_cnt);
+
+bool loadTrace(TraceState& a_trace);
+void replayInstr(TraceState& a_trace, const TraceRegs& a_regs, uint64_t a_instr_cnt);
+void finishReplay(TraceState& a_trace, uint64_t a_instr_cnt);
@@ -1,12 +1,24 @@
 #pragma once
 
+#include "emu_interrupts.hpp"
+#include "emu_memory.hpp"
+#include "emu_mmio.hpp"
+#include "emu_profiler.hpp"
+#include "emu_script.hpp"
+#include "emu_stats.hpp"
+#include "emu_trace.hpp"
+#include <bitset>
+#include <chrono>
 #include <climits>
 #include <stdlib.h>
 #include <stdint.h>
-#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 constexpr std::size_t GPR_NUM = 16;
 constexpr std::size_t CSR_NUM = 3;
+constexpr uint32_t PROGRAM_START = 0x40000000;
 
 struct Instruction{
   uint8_t m_oc;
@@ -26,8 +38,143 @@ struct Instruction{
           m_reg_b(a_reg_b), m_reg_c(a_reg_c), m_disp(a_disp) {}
 };
 
+constexpr uint32_t INSTR_SIZE = 4;
+constexpr uint32_t PAGE_INSTR_NUM = PAGE_SIZE / INSTR_SIZE;
+constexpr uint32_t PAGE_NUM = 1u << (32 - PAGE_BITS);
+
+constexpr uint32_t INSTR_SLOT_MASK = 0xFFFFFFFF / INSTR_SIZE;
+
+/// Decoded instructions of one guest page, indexed by word aligned offset.
+/// m_translated marks slots covered by a superblock; a store to one of them
+/// marks the page as self modifying and it is interpreted from then on.
+struct DecodedPage {
+  std::array<Instruction, PAGE_INSTR_NUM> m_instrs;
+  std::bitset<PAGE_INSTR_NUM> m_valid;
+  std::bitset<PAGE_INSTR_NUM> m_translated;
+  bool m_self_modifying = false;
+};
+
+struct DecodeCache {
+  std::unordered_map<uint32_t, std::unique_ptr<DecodedPage>> m_pages;
+  std::vector<bool> m_code_pages;
+  uint32_t m_last_page_num;
+  DecodedPage* m_last_page;
+
+  DecodeCache() : m_code_pages(PAGE_NUM, false), m_last_page_num(0), m_last_page(nullptr) {}
+};
+
+using InstrHandler = void (*)(const Instruction&);
+
+struct BlockInstr {
+  InstrHandler m_handler;
+  Instruction m_instr;
+
+  BlockInstr(InstrHandler a_handler, const Instruction& a_instr)
+    : m_handler(a_handler), m_instr(a_instr) {}
+};
+
+/// Straight line run of instructions ending with the first one that may
+/// change pc. m_taken and m_fallthrough chain to the blocks that followed
+/// it last time so hot paths skip the block lookup.
+struct Block {
+  uint32_t m_start_pc;
+  uint32_t m_end_pc;
+  bool m_ends_with_halt;
+  std::vector<BlockInstr> m_instrs;
+  Block* m_taken;
+  Block* m_fallthrough;
+
+  Block(uint32_t a_start_pc)
+    : m_start_pc(a_start_pc), m_end_pc(a_start_pc), m_ends_with_halt(false),
+      m_taken(nullptr), m_fallthrough(nullptr) {}
+};
+
+struct BlockCache {
+  std::unordered_map<uint32_t, std::unique_ptr<Block>> m_blocks;
+  bool m_flush_pending = false;
+};
+
+/// The timer counts wall clock milliseconds by default. In virtual time mode
+/// a millisecond is m_instrs_per_ms retired instructions, which makes timer
+/// interrupts land on the same instruction in every run.
+struct TimerState {
+  int32_t m_config_ms = -1;
+  bool m_virtual = false;
+  uint64_t m_instrs_per_ms = 0;
+  uint64_t m_start_instr = 0;
+  std::chrono::steady_clock::time_point m_start_time;
+};
+
+/// A headless terminal types the keys of m_input at their instruction
+/// counts instead of reading stdin, and collects what the guest writes in
+/// m_output, so runs are scriptable and several emulators can run side by
+/// side. The keys come from the m_input_file script, the output is written
+/// to m_output_file, or stdout, at halt.
+struct TerminalState {
+  uint32_t m_in = 0;
+  bool m_headless = false;
+  std::string m_input_file;
+  std::string m_output_file;
+  std::vector<KeyEvent> m_input;
+  std::size_t m_input_pos = 0;
+  std::string m_output;
+};
+
+constexpr uint64_t SNAPSHOT_AT_HALT = UINT64_MAX;
+
+/// The machine is saved to m_file at halt, or at the first device poll
+/// after m_instr instructions. m_failed records that it could not be
+/// written, the run then ends with an error.
+struct SnapshotState {
+  std::string m_file;
+  uint64_t m_instr = SNAPSHOT_AT_HALT;
+  bool m_failed = false;
+};
+
+/// DMA engine registers. Writing the control register runs the whole
+/// transfer at once, the status register then reports how it went.
+struct DmaState {
+  uint32_t m_src = 0;
+  uint32_t m_dst = 0;
+  uint32_t m_len = 0;
+  uint32_t m_status = 0;
+};
+
+/// A guest spinning in a loop that touches neither memory nor devices is
+/// idle until the next interrupt. It is fast-forwarded to the next event in
+/// instruction time, or the host sleeps until the next wall clock event.
+struct IdleState {
+  bool m_enabled = true;
+  uint64_t m_skipped_instrs = 0;
+};
+
 struct Emulator{
-  std::map<uint32_t, uint8_t> m_mem32;
-  uint32_t m_gpr[GPR_NUM];
-  uint32_t m_csr[CSR_NUM];
+  GuestMemory m_mem32;
+  DecodeCache m_decode_cache;
+  BlockCache m_block_cache;
+  uint32_t m_gpr[GPR_NUM] = {};
+  uint32_t m_csr[CSR_NUM] = {};
+  uint64_t m_instr_cnt = 0;
+  uint64_t m_next_poll_instr = 0;
+  TimerState m_timer;
+  TerminalState m_terminal;
+  InterruptController m_irq;
+  DmaState m_dma;
+  IdleState m_idle;
+  EmulatorStats m_stats;
+  Profiler m_profiler;
+  CallGraph m_call_graph;
+  TraceState m_trace;
+  SnapshotState m_snapshot;
 };
+
+extern thread_local Emulator* emulator;
+
+void initDevices();
+void startProgram(uint32_t a_start_pc);
+void execute();
+/// Loads the key script and opens the trace of the run, before execute().
+bool startRun();
+/// Saves the snapshot taken at halt and closes the trace, after execute().
+/// False when the snapshot or the trace could not be written.
+bool finishRun();
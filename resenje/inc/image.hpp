@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/// Binary program image written by the linker with -bin and loaded by the
+/// emulator. All fields are little endian:
+///   "EMUI" | version | segment count
+///   per segment: load address | length | length raw bytes
+constexpr char IMAGE_MAGIC[4] = {'E', 'M', 'U', 'I'};
+constexpr uint32_t IMAGE_VERSION = 1;
+constexpr std::size_t IMAGE_HEADER_SIZE = 12;
+constexpr std::size_t IMAGE_SEGMENT_HEADER_SIZE = 8;
+
+inline uint32_t readLe32(const uint8_t* a_src) {
+  return static_cast<uint32_t>(a_src[0]) |
+    (static_cast<uint32_t>(a_src[1]) << 8) |
+    (static_cast<uint32_t>(a_src[2]) << 16) |
+    (static_cast<uint32_t>(a_src[3]) << 24);
+}
+
+inline void writeLe32(uint8_t* a_dst, uint32_t a_val) {
+  a_dst[0] = static_cast<uint8_t>(a_val & 0xFF);
+  a_dst[1] = static_cast<uint8_t>((a_val >> 8) & 0xFF);
+  a_dst[2] = static_cast<uint8_t>((a_val >> 16) & 0xFF);
+  a_dst[3] = static_cast<uint8_t>((a_val >> 24) & 0xFF);
+}
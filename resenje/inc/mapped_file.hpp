@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+/// Read only view of the whole input file, unmapped on destruction.
+struct MappedFile {
+  const uint8_t* m_data = nullptr;
+  std::size_t m_size = 0;
+
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+};
+
+bool mapFile(const std::string& a_input_file, MappedFile& a_file);
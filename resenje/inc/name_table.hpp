@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using NameId = uint32_t;
+
+/// Interns names into dense ids in first seen order, tables indexed by the
+/// id replace string keyed maps on hot paths.
+struct NameTable {
+  std::unordered_map<std::string, NameId> m_ids;
+  std::vector<const std::string*> m_names;
+
+  NameId intern(const std::string& a_name) {
+    auto it = m_ids.find(a_name);
+    if (it != m_ids.end()) {
+      return it->second;
+    }
+    it = m_ids.emplace(a_name, static_cast<NameId>(m_names.size())).first;
+    m_names.push_back(&it->first);
+    return it->second;
+  }
+
+  const std::string& name(NameId a_id) const {
+    return *m_names[a_id];
+  }
+
+  std::size_t size() const {
+    return m_names.size();
+  }
+};
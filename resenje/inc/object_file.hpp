@@ -0,0 +1,44 @@
+#pragma once
+
+#include "types.hpp"
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// Binary object file written by the assembler and by the linker with
+/// -relocatable. All fields are little endian:
+///   header: "EMUO" | version | string table size | symbol count | section count
+///   string table: NUL terminated symbol and section names
+///   symbols: name | section name | value | index | type | bind | defined | pad
+///   sections: name | data size | relocation count
+///   relocations of every section in section order: offset | symbol | type | addend
+///   section contents in section order
+/// Names are offsets into the string table. The text format is still
+/// written with --text for reading objects by hand.
+constexpr char OBJECT_MAGIC[4] = {'E', 'M', 'U', 'O'};
+constexpr uint32_t OBJECT_VERSION = 1;
+constexpr std::size_t OBJECT_HEADER_SIZE = 20;
+constexpr std::size_t OBJECT_SYMBOL_SIZE = 20;
+constexpr std::size_t OBJECT_SECTION_SIZE = 12;
+constexpr std::size_t OBJECT_RELA_SIZE = 16;
+
+void writeObjectFile(
+  std::ostream& a_out,
+  SymbolTable& a_sym_tab,
+  SectionRelasTable& a_section_relas_table,
+  SectionDataTable& a_section_data_table,
+  std::vector<std::string>& a_sections
+);
+
+/// Section contents are not copied, a_section_views points into a_data.
+bool parseObjectFile(
+  const uint8_t* a_data,
+  std::size_t a_size,
+  SymbolTable& a_sym_tab,
+  SectionRelasTable& a_section_relas_table,
+  SectionViewTable& a_section_views,
+  std::vector<std::string>& a_sections
+);
+
+bool isObjectData(const uint8_t* a_data, std::size_t a_size);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <stdlib.h>
+
+/// Lock free single producer, single consumer ring buffer. One slot is
+/// kept free to tell a full queue from an empty one.
+template <typename T, std::size_t N>
+struct SpscQueue {
+  std::array<T, N> m_buf;
+  alignas(64) std::atomic<std::size_t> m_head{0};
+  alignas(64) std::atomic<std::size_t> m_tail{0};
+
+  bool push(const T& a_val) {
+    std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    std::size_t next = (tail + 1) % N;
+    if (next == m_head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    m_buf[tail] = a_val;
+    m_tail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& a_val) {
+    std::size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    a_val = m_buf[head];
+    m_head.store((head + 1) % N, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+  }
+};
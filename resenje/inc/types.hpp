@@ -76,6 +76,16 @@ struct Rela {
           m_addend(a_addend) {}           
 };
 
+/// Section contents of one input object, left in the mapped input file (or
+/// in the bytes decoded from a text object) until the linker lays out the
+/// output sections.
+struct SectionView{
+  const uint8_t* m_data;
+  uint32_t m_size;
+  SectionView(const uint8_t* a_data = nullptr, uint32_t a_size = 0)
+    : m_data(a_data), m_size(a_size) {}
+};
+
 struct SectionPlace{
   std::string m_sctn_name;
   uint32_t m_addr;
@@ -118,6 +128,7 @@ struct EquUsage{
 using SymbolTable = std::unordered_map<std::string, Sym>;
 using SectionRelasTable = std::unordered_map<std::string, std::vector<Rela>>;
 using SectionDataTable = std::unordered_map<std::string, std::vector<uint8_t>>;
+using SectionViewTable = std::unordered_map<std::string, SectionView>;
 using LiteralUsagesTable = std::unordered_map<uint32_t, std::vector<uint32_t>>;
 using SectionLiteralsTable = std::unordered_map<std::string, std::vector<uint32_t>>;
 using SymbolUsagesTable = std::unordered_map<std::string, std::vector<uint32_t>>;
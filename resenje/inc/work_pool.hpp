@@ -0,0 +1,21 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdlib.h>
+
+/// Task indices owned by one worker. The owner takes from the front, idle
+/// workers steal from the back.
+struct WorkQueue {
+  std::mutex m_lock;
+  std::deque<std::size_t> m_tasks;
+};
+
+/// Runs a_task for every index below a_task_cnt on a_thread_cnt workers,
+/// 0 means one per hardware thread. Returns once all tasks are done.
+void runWorkStealing(
+  std::size_t a_task_cnt, 
+  std::size_t a_thread_cnt, 
+  const std::function<void(std::size_t)>& a_task
+);
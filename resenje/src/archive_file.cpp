@@ -0,0 +1,104 @@
+#include "../inc/archive_file.hpp"
+#include "../inc/image.hpp"
+#include <cstring>
+
+void writeArchiveFile(
+  std::ostream& a_out,
+  const std::vector<ArchiveMember>& a_members,
+  const std::vector<std::pair<std::string, uint32_t>>& a_symbols
+) {
+  std::vector<char> strtab;
+  auto addString = [&] (const std::string& a_str) {
+    uint32_t off = static_cast<uint32_t>(strtab.size());
+    strtab.insert(strtab.end(), a_str.begin(), a_str.end());
+    strtab.push_back('\0');
+    return off;
+  };
+
+  std::vector<uint8_t> member_buf(a_members.size() * ARCHIVE_MEMBER_SIZE);
+  std::vector<uint8_t> symbol_buf(a_symbols.size() * ARCHIVE_SYMBOL_SIZE);
+  std::vector<uint32_t> name_offs;
+  for (const auto& member : a_members) {
+    name_offs.push_back(addString(member.m_name));
+  }
+  for (std::size_t i = 0; i < a_symbols.size(); i++) {
+    writeLe32(symbol_buf.data() + i * ARCHIVE_SYMBOL_SIZE, addString(a_symbols[i].first));
+    writeLe32(symbol_buf.data() + i * ARCHIVE_SYMBOL_SIZE + 4, a_symbols[i].second);
+  }
+
+  uint32_t data_off = static_cast<uint32_t>(
+    ARCHIVE_HEADER_SIZE + member_buf.size() + symbol_buf.size() + strtab.size()
+  );
+  for (std::size_t i = 0; i < a_members.size(); i++) {
+    uint8_t* entry = member_buf.data() + i * ARCHIVE_MEMBER_SIZE;
+    writeLe32(entry, name_offs[i]);
+    writeLe32(entry + 4, data_off);
+    writeLe32(entry + 8, a_members[i].m_size);
+    data_off+= a_members[i].m_size;
+  }
+
+  uint8_t header[ARCHIVE_HEADER_SIZE];
+  std::memcpy(header, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+  writeLe32(header + 4, ARCHIVE_VERSION);
+  writeLe32(header + 8, static_cast<uint32_t>(a_members.size()));
+  writeLe32(header + 12, static_cast<uint32_t>(a_symbols.size()));
+  writeLe32(header + 16, static_cast<uint32_t>(strtab.size()));
+
+  a_out.write(reinterpret_cast<const char*>(header), ARCHIVE_HEADER_SIZE);
+  a_out.write(reinterpret_cast<const char*>(member_buf.data()), member_buf.size());
+  a_out.write(reinterpret_cast<const char*>(symbol_buf.data()), symbol_buf.size());
+  a_out.write(strtab.data(), strtab.size());
+  for (const auto& member : a_members) {
+    a_out.write(reinterpret_cast<const char*>(member.m_data), member.m_size);
+  }
+}
+
+bool isArchiveData(const uint8_t* a_data, std::size_t a_size) {
+  return a_size >= sizeof(ARCHIVE_MAGIC) &&
+    std::memcmp(a_data, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) == 0;
+}
+
+/// Only the header, member table and symbol index are read, member
+/// contents stay in a_data until the linker extracts them.
+bool parseArchiveFile(const uint8_t* a_data, std::size_t a_size, ArchiveIndex& a_index) {
+  if (a_size < ARCHIVE_HEADER_SIZE || !isArchiveData(a_data, a_size) ||
+      readLe32(a_data + 4) != ARCHIVE_VERSION) {
+    return false;
+  }
+  uint64_t member_cnt = readLe32(a_data + 8);
+  uint64_t symbol_cnt = readLe32(a_data + 12);
+  uint64_t strtab_size = readLe32(a_data + 16);
+
+  uint64_t member_off = ARCHIVE_HEADER_SIZE;
+  uint64_t symbol_off = member_off + member_cnt * ARCHIVE_MEMBER_SIZE;
+  uint64_t strtab_off = symbol_off + symbol_cnt * ARCHIVE_SYMBOL_SIZE;
+  if (strtab_off + strtab_size > a_size || 
+      (strtab_size > 0 && a_data[strtab_off + strtab_size - 1] != '\0')) {
+    return false;
+  }
+  const char* strtab = reinterpret_cast<const char*>(a_data + strtab_off);
+
+  a_index.m_members.reserve(member_cnt);
+  for (uint64_t i = 0; i < member_cnt; i++) {
+    const uint8_t* entry = a_data + member_off + i * ARCHIVE_MEMBER_SIZE;
+    uint32_t name_off = readLe32(entry);
+    uint64_t data_off = readLe32(entry + 4);
+    uint32_t size = readLe32(entry + 8);
+    if (name_off >= strtab_size || data_off + size > a_size) {
+      return false;
+    }
+    a_index.m_members.emplace_back(strtab + name_off, a_data + data_off, size);
+  }
+
+  a_index.m_symbols.reserve(symbol_cnt);
+  for (uint64_t i = 0; i < symbol_cnt; i++) {
+    const uint8_t* entry = a_data + symbol_off + i * ARCHIVE_SYMBOL_SIZE;
+    uint32_t name_off = readLe32(entry);
+    uint32_t member = readLe32(entry + 4);
+    if (name_off >= strtab_size || member >= member_cnt) {
+      return false;
+    }
+    a_index.m_symbols.emplace(strtab + name_off, member);
+  }
+  return true;
+}
@@ -1,5 +1,6 @@
 #include "../inc/asembler.hpp"
 #include "../inc/instructions.hpp"
+#include "../inc/object_file.hpp"
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -329,7 +330,11 @@ void writeSymbolPool(std::ofstream& a_out){
   a_out<<"\n\n";
 }
 
-void writeObj(std::ofstream& a_out){
+void writeObj(std::ofstream& a_out, bool a_text_mode){
+  if (!a_text_mode) {
+    writeObjectFile(a_out, sym_tab, section_relas_table, section_data_table, sections);
+    return;
+  }
   writeSymTab(a_out, sym_tab);
   writeRela(a_out, section_relas_table, sections);
   writeSections(a_out, section_data_table, sections, sym_tab, false);
@@ -402,17 +407,28 @@ extern int yyparse();
 int main(int argc, char* argv[]) {
     std::string input_file;
     std::string output_file = "build/out.o";
+    bool text_mode = false;
+
+    /// --text writes the object in the old text format, for reading by hand
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--text") {
+            text_mode = true;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
 
-    if (argc == 2) {
-        input_file = argv[1];
+    if (args.size() == 1) {
+        input_file = args[0];
     }
-    else if (argc == 4) {
-        if (std::string(argv[1]) == "-o") {
-            output_file = argv[2];
-            input_file = argv[3];
-        } else if (std::string(argv[2]) == "-o") {
-            input_file = argv[1];
-            output_file = argv[3];
+    else if (args.size() == 3) {
+        if (args[0] == "-o") {
+            output_file = args[1];
+            input_file = args[2];
+        } else if (args[1] == "-o") {
+            input_file = args[0];
+            output_file = args[2];
         } else {
             std::cerr << "Greška: neispravna upotreba opcije -o\n";
             return 1;
@@ -440,13 +456,13 @@ int main(int argc, char* argv[]) {
       return 1;
     }
 
-    std::ofstream out(output_file);
+    std::ofstream out(output_file, text_mode ? std::ios::out : std::ios::binary);
     if (!out) {
         std::cerr << "Greška: ne mogu da otvorim izlaznu datoteku " << output_file << "\n";
         return 1;
     }
   
-    writeObj(out);
+    writeObj(out, text_mode);
 
     out.close();
     fclose(yyin);
@@ -35,7 +35,7 @@ void section_(const std::string& a_sym_name){
 }
 
 void skip_(uint32_t a_literal){
-  for(uint8_t i = 0; i < a_literal; i++){
+  for(uint32_t i = 0; i < a_literal; i++){
         writeByte(0x00);
   }
 }
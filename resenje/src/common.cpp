@@ -1,5 +1,7 @@
 #include "../inc/common.hpp"
+#include "../inc/image.hpp"
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -128,18 +130,9 @@ void updateWord(
   );
 }
 
-void writeSymTab(std::ostream& a_out, SymbolTable& a_sym_tab){  
-  a_out << "#.symtab\n";
-  a_out << std::left
-          << std::setw(6)  << "Num"
-          << std::setw(10) << "Value"
-          << std::setw(4)  << "Size"
-          << std::setw(9)  << "  Type"
-          << std::setw(6)  << "Bind"
-          << std::setw(20) << "Sctn"
-          << std::setw(4) << "Name"
-          << "\n";
-
+/// Section symbols first, then the rest in definition order, renumbered
+/// from zero. Both object formats write symbols in this order.
+SymbolList sortSymbols(SymbolTable& a_sym_tab) {
   SymbolList sorted_syms;
   sorted_syms.reserve(a_sym_tab.size());
 
@@ -159,6 +152,30 @@ void writeSymTab(std::ostream& a_out, SymbolTable& a_sym_tab){
   uint32_t sym_tab_cnt = 0;
   for(auto& sym: sorted_syms){
     sym.m_index = sym_tab_cnt++;
+  }
+  return sorted_syms;
+}
+
+void sortRelas(std::vector<Rela>& a_relas) {
+  std::sort(a_relas.begin(), a_relas.end(), 
+    [](const auto& a_left, const auto& a_right){
+      return a_left.m_offset < a_right.m_offset;
+  });
+}
+
+void writeSymTab(std::ostream& a_out, SymbolTable& a_sym_tab){  
+  a_out << "#.symtab\n";
+  a_out << std::left
+          << std::setw(6)  << "Num"
+          << std::setw(10) << "Value"
+          << std::setw(4)  << "Size"
+          << std::setw(9)  << "  Type"
+          << std::setw(6)  << "Bind"
+          << std::setw(20) << "Sctn"
+          << std::setw(4) << "Name"
+          << "\n";
+
+  for(const auto& sym: sortSymbols(a_sym_tab)){
      a_out << std::left
               << std::setw(SymTabLayout::NUM_WIDTH) << sym.m_index
               << std::setw(SymTabLayout::VAL_WIDTH) << std::hex << std::right << std::setfill('0') 
@@ -190,10 +207,7 @@ void writeRela(
               << std::setw(8)  << "Addend"
               << "\n";
 
-    std::sort(a_section_relas_table[section].begin(), a_section_relas_table[section].end(), 
-      [](const auto& a_left, const auto& a_right){
-        return a_left.m_offset < a_right.m_offset;
-    });
+    sortRelas(a_section_relas_table[section]);
     for (const auto& rela : a_section_relas_table[section]){
       a_out << std::left
                 << std::setw(RelaLayout::OFFSET_WIDTH)  << std::hex << std::right << std::setfill('0') << 
@@ -259,3 +273,25 @@ void writeSections(
     }
   }
 }
+
+void writeImage(
+  std::ostream& a_out,
+  SectionDataTable& a_section_data_table,
+  std::vector<std::string>& a_sections,
+  SymbolTable& a_sym_tab
+) {
+  uint8_t header[IMAGE_HEADER_SIZE];
+  std::memcpy(header, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+  writeLe32(header + 4, IMAGE_VERSION);
+  writeLe32(header + 8, static_cast<uint32_t>(a_sections.size()));
+  a_out.write(reinterpret_cast<const char*>(header), IMAGE_HEADER_SIZE);
+
+  for (const auto& section : a_sections) {
+    const auto& data = a_section_data_table[section];
+    uint8_t segment_header[IMAGE_SEGMENT_HEADER_SIZE];
+    writeLe32(segment_header, a_sym_tab[section].m_value);
+    writeLe32(segment_header + 4, static_cast<uint32_t>(data.size()));
+    a_out.write(reinterpret_cast<const char*>(segment_header), IMAGE_SEGMENT_HEADER_SIZE);
+    a_out.write(reinterpret_cast<const char*>(data.data()), data.size());
+  }
+}
@@ -0,0 +1,138 @@
+#include "../inc/emu_batch.hpp"
+#include "../inc/emu_loader.hpp"
+#include "../inc/emu_snapshot.hpp"
+#include "../inc/work_pool.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+bool readBatchList(const std::string& a_list_file, std::vector<BatchRun>& a_runs) {
+  std::ifstream list(a_list_file);
+  if (!list.is_open()) {
+    std::cerr << "Greska prilikom otvaranja fajla: " << a_list_file << "\n";
+    return false;
+  }
+  std::string line;
+  while (std::getline(list, line)) {
+    std::istringstream fields(line);
+    BatchRun run;
+    if (!(fields >> run.m_program_file) || run.m_program_file[0] == '#') {
+      continue;
+    }
+    fields >> run.m_input_file;
+    a_runs.push_back(run);
+  }
+  return true;
+}
+
+/// Each worker thread owns the emulator of the run it executes, the
+/// thread local emulator pointer routes the instruction handlers to it.
+void executeBatchRun(const BatchConfig& a_config, std::size_t a_ndx, BatchRun& a_run) {
+  auto instance = std::make_unique<Emulator>();
+  emulator = instance.get();
+  instance->m_terminal.m_headless = true;
+  instance->m_terminal.m_input_file = a_run.m_input_file.empty() ? a_config.m_input_file : a_run.m_input_file;
+  instance->m_idle.m_enabled = a_config.m_idle;
+  std::string suffix = "." + std::to_string(a_ndx);
+  if (!a_config.m_snapshot.m_file.empty()) {
+    instance->m_snapshot.m_file = a_config.m_snapshot.m_file + suffix;
+    instance->m_snapshot.m_instr = a_config.m_snapshot.m_instr;
+  }
+  instance->m_trace.m_recording = a_config.m_trace_recording;
+  instance->m_trace.m_replaying = a_config.m_trace_replaying;
+  if (!a_config.m_trace_file.empty()) {
+    instance->m_trace.m_file = a_config.m_trace_file + suffix;
+  }
+
+  instance->m_timer = a_config.m_timer;
+
+  bool loaded = true;
+  if (isSnapshotFile(a_run.m_program_file)) {
+    loaded = restoreSnapshot(*instance, a_run.m_program_file);
+    if (!loaded) {
+      std::cerr << "Greska: Neispravan snimak stanja: " << a_run.m_program_file << std::endl;
+    }
+  } else {
+    loaded = loadProgram(instance->m_mem32, a_run.m_program_file) == 0;
+    if (loaded) {
+      startProgram(PROGRAM_START);
+    }
+  }
+
+  if (loaded && startRun()) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    execute();
+    auto end_time = std::chrono::high_resolution_clock::now();
+    bool finished = finishRun();
+    a_run.m_seconds = std::chrono::duration<double>(end_time - start_time).count();
+    a_run.m_instr_cnt = instance->m_instr_cnt;
+    a_run.m_output = std::move(instance->m_terminal.m_output);
+    std::copy(instance->m_gpr, instance->m_gpr + GPR_NUM, a_run.m_gpr);
+    a_run.m_divergence = instance->m_trace.m_divergence;
+    a_run.m_ok = finished && !instance->m_trace.m_diverged;
+  }
+  emulator = nullptr;
+}
+
+double mips(uint64_t a_instr_cnt, double a_seconds) {
+  return a_seconds > 0 ? a_instr_cnt / a_seconds / 1e6 : 0.0;
+}
+
+void showBatchRun(std::size_t a_ndx, const BatchRun& a_run) {
+  std::cout << "[" << a_ndx << "] " << a_run.m_program_file;
+  if (!a_run.m_input_file.empty()) {
+    std::cout << " < " << a_run.m_input_file;
+  }
+  if (!a_run.m_ok) {
+    std::cout << ": FAILED" << std::endl;
+    if (!a_run.m_divergence.empty()) {
+      std::cerr << a_run.m_divergence << std::endl;
+    }
+    return;
+  }
+  std::cout << ": " << a_run.m_instr_cnt << " instrs, " 
+    << std::fixed << std::setprecision(3) << a_run.m_seconds << " s, " 
+    << std::setprecision(1) << mips(a_run.m_instr_cnt, a_run.m_seconds) << " MIPS, " 
+    << a_run.m_output.size() << " output bytes, r1=0x" 
+    << std::hex << std::setw(8) << std::setfill('0') << a_run.m_gpr[1] 
+    << std::dec << std::setfill(' ') << std::endl;
+}
+
+int32_t runBatch(const BatchConfig& a_config) {
+  std::vector<BatchRun> runs;
+  if (!readBatchList(a_config.m_list_file, runs)) {
+    return 1;
+  }
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  runWorkStealing(runs.size(), a_config.m_jobs, [&] (std::size_t a_ndx) {
+    executeBatchRun(a_config, a_ndx, runs[a_ndx]);
+  });
+  auto end_time = std::chrono::high_resolution_clock::now();
+  double seconds = std::chrono::duration<double>(end_time - start_time).count();
+
+  uint64_t total_instrs = 0;
+  std::size_t failed = 0;
+  for (std::size_t i = 0; i < runs.size(); i++) {
+    showBatchRun(i, runs[i]);
+    total_instrs+= runs[i].m_instr_cnt;
+    failed+= runs[i].m_ok ? 0 : 1;
+    if (runs[i].m_ok && !a_config.m_output_dir.empty()) {
+      std::string out_file = a_config.m_output_dir + "/" + std::to_string(i) + ".out";
+      std::ofstream out(out_file, std::ios::binary);
+      if (!out.write(runs[i].m_output.data(), runs[i].m_output.size())) {
+        std::cerr << "Greska prilikom pisanja fajla: " << out_file << "\n";
+        failed++;
+      }
+    }
+  }
+
+  std::cout << "Batch: " << runs.size() << " runs, " << failed << " failed, " 
+    << total_instrs << " instrs in " << std::fixed << std::setprecision(3) << seconds << " s, " 
+    << std::setprecision(1) << mips(total_instrs, seconds) << " MIPS aggregate" << std::endl;
+  return failed == 0 ? 0 : 1;
+}
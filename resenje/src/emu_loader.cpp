@@ -0,0 +1,108 @@
+#include "../inc/emu_loader.hpp"
+#include "../inc/image.hpp"
+#include "../inc/mapped_file.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+int32_t loadImage(GuestMemory& a_mem, const MappedFile& a_file) {
+  const uint8_t* pos = a_file.m_data;
+  const uint8_t* end = a_file.m_data + a_file.m_size;
+  if (end - pos < static_cast<std::ptrdiff_t>(IMAGE_HEADER_SIZE) || 
+      readLe32(pos + 4) != IMAGE_VERSION) {
+    std::cerr << "Greska: Neispravno zaglavlje binarne slike" << std::endl;
+    return 1;
+  }
+  uint32_t segment_cnt = readLe32(pos + 8);
+  pos+= IMAGE_HEADER_SIZE;
+
+  for (uint32_t i = 0; i < segment_cnt; i++) {
+    if (end - pos < static_cast<std::ptrdiff_t>(IMAGE_SEGMENT_HEADER_SIZE)) {
+      std::cerr << "Greska: Binarna slika je skracena" << std::endl;
+      return 1;
+    }
+    uint32_t addr = readLe32(pos);
+    uint32_t len = readLe32(pos + 4);
+    pos+= IMAGE_SEGMENT_HEADER_SIZE;
+    if (static_cast<std::size_t>(end - pos) < len) {
+      std::cerr << "Greska: Binarna slika je skracena" << std::endl;
+      return 1;
+    }
+    memWriteBlock(a_mem, addr, pos, len);
+    pos+= len;
+  }
+  return 0;
+}
+
+int8_t hexDigit(uint8_t a_c) {
+  if (a_c >= '0' && a_c <= '9') {
+    return a_c - '0';
+  } else if (a_c >= 'A' && a_c <= 'F') {
+    return a_c - 'A' + 10;
+  } else if (a_c >= 'a' && a_c <= 'f') {
+    return a_c - 'a' + 10;
+  }
+  return -1;
+}
+
+/// Hand written parser for lines of the form "AAAAAAAA: BB BB BB BB   BB ...".
+/// Bytes at consecutive addresses are collected into one run and copied into
+/// guest memory page by page.
+int32_t loadHex(GuestMemory& a_mem, const MappedFile& a_file) {
+  const uint8_t* pos = a_file.m_data;
+  const uint8_t* end = a_file.m_data + a_file.m_size;
+  std::vector<uint8_t> run;
+  uint32_t run_addr = 0;
+
+  while (pos < end) {
+    uint32_t addr = 0;
+    while (pos < end && hexDigit(*pos) >= 0) {
+      addr = (addr << 4) | hexDigit(*pos++);
+    }
+    if (pos == end || *pos != ':') {
+      std::cerr << "Greska: Neispravan format hex fajla" << std::endl;
+      return 1;
+    }
+    pos++;
+
+    if (run_addr + run.size() != addr) {
+      memWriteBlock(a_mem, run_addr, run.data(), run.size());
+      run.clear();
+      run_addr = addr;
+    }
+
+    while (pos < end && *pos != '\n') {
+      if (*pos == ' ' || *pos == '\t' || *pos == '\r') {
+        pos++;
+        continue;
+      }
+      if (end - pos < 2 || hexDigit(pos[0]) < 0 || hexDigit(pos[1]) < 0) {
+        std::cerr << "Greska: Neispravan format hex fajla" << std::endl;
+        return 1;
+      }
+      run.push_back(static_cast<uint8_t>((hexDigit(pos[0]) << 4) | hexDigit(pos[1])));
+      pos+= 2;
+    }
+    if (pos < end) {
+      pos++;
+    }
+  }
+
+  memWriteBlock(a_mem, run_addr, run.data(), run.size());
+  return 0;
+}
+
+int32_t loadProgram(GuestMemory& a_mem, const std::string& a_input_file) {
+  MappedFile file;
+  if (!mapFile(a_input_file, file)) {
+    std::cerr << "Greska prilikom otvaranja fajla: " << a_input_file << "\n";
+    return 1;
+  }
+
+  if (file.m_size >= sizeof(IMAGE_MAGIC) && 
+      std::memcmp(file.m_data, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) == 0) {
+    return loadImage(a_mem, file);
+  }
+  return loadHex(a_mem, file);
+}
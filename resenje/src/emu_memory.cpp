@@ -0,0 +1,112 @@
+#include "../inc/emu_memory.hpp"
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+
+GuestMemory::~GuestMemory() {
+  if (m_mapping != nullptr) {
+    munmap(m_mapping, m_mapping_size);
+  }
+}
+
+Page*& pageSlot(GuestMemory& a_mem, uint32_t a_addr) {
+  std::unique_ptr<PageTable>& table = a_mem.m_page_dir[pageDirIndex(a_addr)];
+  if (table == nullptr) {
+    table = std::make_unique<PageTable>();
+  }
+  return (*table)[pageTableIndex(a_addr)];
+}
+
+uint8_t* allocPage(GuestMemory& a_mem, uint32_t a_addr) {
+  Page*& page = pageSlot(a_mem, a_addr);
+  if (page == nullptr) {
+    a_mem.m_owned_pages.push_back(std::make_unique<Page>());
+    page = a_mem.m_owned_pages.back().get();
+  }
+  return page->data();
+}
+
+void mapPage(GuestMemory& a_mem, uint32_t a_addr, Page* a_page) {
+  pageSlot(a_mem, a_addr) = a_page;
+}
+
+/// Slow paths handle words that straddle a page boundary byte by byte.
+uint32_t memReadWordSlow(const GuestMemory& a_mem, uint32_t a_addr) {
+  return static_cast<uint32_t>(memReadByte(a_mem, a_addr)) |
+    (static_cast<uint32_t>(memReadByte(a_mem, a_addr + 1)) << 8) |
+    (static_cast<uint32_t>(memReadByte(a_mem, a_addr + 2)) << 16) |
+    (static_cast<uint32_t>(memReadByte(a_mem, a_addr + 3)) << 24);
+}
+
+uint32_t memReadInstrSlow(const GuestMemory& a_mem, uint32_t a_addr) {
+  return (static_cast<uint32_t>(memReadByte(a_mem, a_addr)) << 24) |
+    (static_cast<uint32_t>(memReadByte(a_mem, a_addr + 1)) << 16) |
+    (static_cast<uint32_t>(memReadByte(a_mem, a_addr + 2)) << 8) |
+    static_cast<uint32_t>(memReadByte(a_mem, a_addr + 3));
+}
+
+void memWriteWordSlow(GuestMemory& a_mem, uint32_t a_addr, uint32_t a_word) {
+  memWriteByte(a_mem, a_addr, static_cast<uint8_t>(a_word & 0xFF));
+  memWriteByte(a_mem, a_addr + 1, static_cast<uint8_t>((a_word >> 8) & 0xFF));
+  memWriteByte(a_mem, a_addr + 2, static_cast<uint8_t>((a_word >> 16) & 0xFF));
+  memWriteByte(a_mem, a_addr + 3, static_cast<uint8_t>((a_word >> 24) & 0xFF));
+}
+
+void memWriteBlock(GuestMemory& a_mem, uint32_t a_addr, const uint8_t* a_src, std::size_t a_len) {
+  while (a_len > 0) {
+    uint32_t off = a_addr & PAGE_OFFSET_MASK;
+    std::size_t chunk = std::min<std::size_t>(a_len, PAGE_SIZE - off);
+    std::memcpy(touchPage(a_mem, a_addr) + off, a_src, chunk);
+    a_addr+= chunk;
+    a_src+= chunk;
+    a_len-= chunk;
+  }
+}
+
+/// Largest run starting at a_addr that stays inside one page.
+uint32_t pageChunk(uint32_t a_addr, uint32_t a_len) {
+  return std::min(a_len, PAGE_SIZE - (a_addr & PAGE_OFFSET_MASK));
+}
+
+void memCopy(GuestMemory& a_mem, uint32_t a_dst, uint32_t a_src, uint32_t a_len) {
+  if (a_dst == a_src || a_len == 0) {
+    return;
+  }
+  // a destination above an overlapping source is copied from the end down
+  bool backward = a_dst > a_src && a_dst - a_src < a_len;
+  uint32_t done = 0;
+  while (done < a_len) {
+    uint32_t left = a_len - done;
+    uint32_t chunk;
+    uint32_t dst;
+    uint32_t src;
+    if (backward) {
+      uint32_t dst_last = a_dst + left - 1;
+      uint32_t src_last = a_src + left - 1;
+      chunk = std::min({left, (dst_last & PAGE_OFFSET_MASK) + 1, (src_last & PAGE_OFFSET_MASK) + 1});
+      dst = dst_last - chunk + 1;
+      src = src_last - chunk + 1;
+    } else {
+      dst = a_dst + done;
+      src = a_src + done;
+      chunk = std::min(pageChunk(dst, left), pageChunk(src, left));
+    }
+    uint8_t* dst_page = touchPage(a_mem, dst) + (dst & PAGE_OFFSET_MASK);
+    const uint8_t* src_page = findPage(a_mem, src);
+    if (src_page == nullptr) {
+      std::memset(dst_page, 0, chunk);
+    } else {
+      std::memmove(dst_page, src_page + (src & PAGE_OFFSET_MASK), chunk);
+    }
+    done+= chunk;
+  }
+}
+
+void memFill(GuestMemory& a_mem, uint32_t a_dst, uint8_t a_byte, uint32_t a_len) {
+  while (a_len > 0) {
+    uint32_t chunk = pageChunk(a_dst, a_len);
+    std::memset(touchPage(a_mem, a_dst) + (a_dst & PAGE_OFFSET_MASK), a_byte, chunk);
+    a_dst+= chunk;
+    a_len-= chunk;
+  }
+}
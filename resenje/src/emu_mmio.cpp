@@ -0,0 +1,30 @@
+#include "../inc/emu_mmio.hpp"
+
+MmioSlot mmio_slots[MMIO_SLOT_NUM];
+
+uint32_t mmioSlot(uint32_t a_addr) {
+  return (a_addr - MMIO_BASE) / 4;
+}
+
+void registerMmioDevice(
+  uint32_t a_base, 
+  uint32_t a_size, 
+  MmioReadHandler a_read, 
+  MmioWriteHandler a_write
+) {
+  for (uint32_t addr = a_base; addr - a_base < a_size && isMmioAddr(addr); addr+= 4) {
+    mmio_slots[mmioSlot(addr)] = MmioSlot{a_read, a_write};
+  }
+}
+
+uint32_t mmioRead(uint32_t a_addr) {
+  const MmioSlot& slot = mmio_slots[mmioSlot(a_addr)];
+  return slot.m_read != nullptr ? slot.m_read(a_addr) : 0x00000000;
+}
+
+void mmioWrite(uint32_t a_addr, uint32_t a_val) {
+  const MmioSlot& slot = mmio_slots[mmioSlot(a_addr)];
+  if (slot.m_write != nullptr) {
+    slot.m_write(a_addr, a_val);
+  }
+}
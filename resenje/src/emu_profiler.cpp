@@ -0,0 +1,261 @@
+#include "../inc/emu_profiler.hpp"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+const std::string SECTION_TYPE = "SCTN";
+const std::string EQU_SCTN = "#EQU";
+const std::string UNDEFINED_SCTN_NAME = "UND";
+
+const uint32_t NO_RET_SLOT = 0xFFFFFFFF;
+
+uint64_t edgeKey(uint32_t a_caller, uint32_t a_callee) {
+  return (static_cast<uint64_t>(a_caller) << 32) | a_callee;
+}
+
+void callGraphCall(CallGraph& a_graph, uint32_t a_ret_slot) {
+  a_graph.m_entry_pending = true;
+  a_graph.m_pending_slot = a_ret_slot;
+}
+
+/// Opens the frame of a pending call at its first instruction. The first
+/// instruction of the program opens the root frame.
+void callGraphEnter(CallGraph& a_graph, uint32_t a_func, uint64_t a_enter_instr) {
+  uint32_t ret_slot = a_graph.m_entry_pending ? a_graph.m_pending_slot : NO_RET_SLOT;
+  a_graph.m_entry_pending = false;
+  if (a_graph.m_stack.size() >= MAX_SHADOW_DEPTH) {
+    a_graph.m_untracked_depth++;
+    a_graph.m_untracked_calls++;
+    return;
+  }
+  if (!a_graph.m_stack.empty()) {
+    CallEdge& edge = a_graph.m_edges[edgeKey(a_graph.m_stack.back().m_func, a_func)];
+    edge.m_calls++;
+    edge.m_active++;
+  }
+  a_graph.m_funcs[a_func].m_calls++;
+  a_graph.m_active[a_func]++;
+  a_graph.m_stack.push_back(ShadowFrame{a_func, ret_slot, a_enter_instr, 0});
+}
+
+void popFrame(CallGraph& a_graph, uint64_t a_instr_cnt) {
+  ShadowFrame frame = a_graph.m_stack.back();
+  a_graph.m_stack.pop_back();
+
+  uint64_t inclusive = a_instr_cnt - frame.m_enter_instr;
+  FuncProfile& func = a_graph.m_funcs[frame.m_func];
+  func.m_exclusive+= inclusive - frame.m_child_instrs;
+  // recursive activations are already covered by the outermost one
+  if (--a_graph.m_active[frame.m_func] == 0) {
+    func.m_inclusive+= inclusive;
+  }
+  if (!a_graph.m_stack.empty()) {
+    ShadowFrame& caller = a_graph.m_stack.back();
+    caller.m_child_instrs+= inclusive;
+    CallEdge& edge = a_graph.m_edges[edgeKey(caller.m_func, frame.m_func)];
+    if (--edge.m_active == 0) {
+      edge.m_instrs+= inclusive;
+    }
+  }
+}
+
+void callGraphReturn(CallGraph& a_graph, uint32_t a_ret_slot, uint64_t a_instr_cnt) {
+  if (a_graph.m_stack.empty()) {
+    return;
+  }
+  if (a_graph.m_stack.back().m_ret_slot != a_ret_slot && a_graph.m_untracked_depth > 0) {
+    a_graph.m_untracked_depth--;
+    return;
+  }
+  auto it = std::find_if(
+    a_graph.m_stack.rbegin(), 
+    a_graph.m_stack.rend(), 
+    [a_ret_slot] (const ShadowFrame& a_frame) {
+      return a_frame.m_ret_slot == a_ret_slot;
+    }
+  );
+  if (it == a_graph.m_stack.rend()) {
+    return;
+  }
+  std::size_t depth = a_graph.m_stack.rend() - it - 1;
+  while (a_graph.m_stack.size() > depth) {
+    popFrame(a_graph, a_instr_cnt);
+  }
+}
+
+/// Frames still open at halt are closed as if they returned there.
+void finishCallGraph(CallGraph& a_graph, uint64_t a_instr_cnt) {
+  while (!a_graph.m_stack.empty()) {
+    popFrame(a_graph, a_instr_cnt);
+  }
+}
+
+bool loadSymbolMap(const std::string& a_symtab_file, SymbolMap& a_map) {
+  std::ifstream in(a_symtab_file);
+  if (!in.is_open()) {
+    return false;
+  }
+
+  std::string line;
+  std::getline(in, line); /// #.symtab
+  std::getline(in, line); /// symtab header
+  while (std::getline(in, line) && !line.empty() && line[0] != '#') {
+    std::istringstream iss(line);
+    std::string num, val, size, type, bind, sctn_name, name;
+    if (!(iss >> num >> val >> size >> type >> bind >> sctn_name >> name)) {
+      continue;
+    }
+    if (sctn_name == EQU_SCTN || sctn_name == UNDEFINED_SCTN_NAME) {
+      continue;
+    }
+    uint32_t addr = 0;
+    auto result = std::from_chars(val.data(), val.data() + val.size(), addr, 16);
+    if (result.ec != std::errc() || result.ptr != val.data() + val.size()) {
+      return false;
+    }
+    SymbolEntry entry{addr, name, sctn_name};
+    if (type == SECTION_TYPE) {
+      a_map.m_sections.push_back(entry);
+    } else {
+      a_map.m_labels.push_back(entry);
+    }
+  }
+
+  auto by_addr = [] (const SymbolEntry& a_lhs, const SymbolEntry& a_rhs) {
+    return a_lhs.m_addr < a_rhs.m_addr;
+  };
+  std::stable_sort(a_map.m_sections.begin(), a_map.m_sections.end(), by_addr);
+  std::stable_sort(a_map.m_labels.begin(), a_map.m_labels.end(), by_addr);
+  return true;
+}
+
+/// Last entry at or below a_addr, nullptr if there is none.
+const SymbolEntry* precedingEntry(const std::vector<SymbolEntry>& a_entries, uint32_t a_addr) {
+  auto it = std::upper_bound(
+    a_entries.begin(), 
+    a_entries.end(), 
+    a_addr,
+    [] (uint32_t a_val, const SymbolEntry& a_entry) {
+      return a_val < a_entry.m_addr;
+    }
+  );
+  return it == a_entries.begin() ? nullptr : &*(it - 1);
+}
+
+/// "section;label" for the nearest preceding label of the same section, the
+/// section alone before its first label and the raw address without symbols.
+std::string symbolize(const SymbolMap& a_map, uint32_t a_addr) {
+  const SymbolEntry* sctn = precedingEntry(a_map.m_sections, a_addr);
+  if (sctn == nullptr) {
+    std::ostringstream name;
+    name << "0x" << std::hex << std::setw(8) << std::setfill('0') << a_addr;
+    return name.str();
+  }
+  const SymbolEntry* label = precedingEntry(a_map.m_labels, a_addr);
+  if (label == nullptr || label->m_addr < sctn->m_addr || label->m_sctn_name != sctn->m_name) {
+    return sctn->m_name;
+  }
+  return sctn->m_name + ";" + label->m_name;
+}
+
+int32_t showProfile(const Profiler& a_profiler) {
+  SymbolMap map;
+  if (!a_profiler.m_symtab_file.empty() && !loadSymbolMap(a_profiler.m_symtab_file, map)) {
+    std::cerr << "Greska prilikom otvaranja fajla: " << a_profiler.m_symtab_file << "\n";
+    return 1;
+  }
+
+  std::unordered_map<std::string, uint64_t> symbol_samples;
+  uint64_t total = 0;
+  for (const auto& [pc, cnt] : a_profiler.m_samples) {
+    symbol_samples[symbolize(map, pc)]+= cnt;
+    total+= cnt;
+  }
+
+  std::vector<std::pair<std::string, uint64_t>> flat(symbol_samples.begin(), symbol_samples.end());
+  std::sort(flat.begin(), flat.end(), [] (const auto& a_lhs, const auto& a_rhs) {
+    return a_lhs.second != a_rhs.second ? a_lhs.second > a_rhs.second : a_lhs.first < a_rhs.first;
+  });
+
+  std::cerr << "Flat profile (" << total << " samples, every " 
+    << a_profiler.m_interval << " instructions):\n"
+    << std::right << std::setw(10) << "Samples" << std::setw(9) << "%" 
+    << std::setw(9) << "Cum %" << "  Symbol\n";
+  uint64_t cumulative = 0;
+  for (const auto& [symbol, cnt] : flat) {
+    cumulative+= cnt;
+    std::cerr << std::setw(10) << cnt << std::fixed << std::setprecision(2)
+      << std::setw(9) << 100.0 * cnt / std::max<uint64_t>(total, 1) 
+      << std::setw(9) << 100.0 * cumulative / std::max<uint64_t>(total, 1) << "  " << symbol << "\n";
+  }
+  std::cerr << std::flush;
+
+  if (!a_profiler.m_folded_file.empty()) {
+    std::ofstream out(a_profiler.m_folded_file);
+    if (!out.is_open()) {
+      std::cerr << "Greska prilikom otvaranja fajla: " << a_profiler.m_folded_file << "\n";
+      return 1;
+    }
+    for (const auto& [symbol, cnt] : flat) {
+      out << symbol << " " << cnt << "\n";
+    }
+  }
+  return 0;
+}
+
+/// Function name for an entry address: the symbol that starts there, or the
+/// symbolized address when the entry has no label.
+std::string funcName(const SymbolMap& a_map, uint32_t a_func) {
+  std::string name = symbolize(a_map, a_func);
+  std::size_t sep = name.find(';');
+  return sep == std::string::npos ? name : name.substr(sep + 1);
+}
+
+int32_t showCallGraph(const CallGraph& a_graph, const std::string& a_symtab_file) {
+  SymbolMap map;
+  if (!a_symtab_file.empty() && !loadSymbolMap(a_symtab_file, map)) {
+    std::cerr << "Greska prilikom otvaranja fajla: " << a_symtab_file << "\n";
+    return 1;
+  }
+
+  std::vector<std::pair<uint32_t, FuncProfile>> funcs(a_graph.m_funcs.begin(), a_graph.m_funcs.end());
+  std::sort(funcs.begin(), funcs.end(), [] (const auto& a_lhs, const auto& a_rhs) {
+    return a_lhs.second.m_inclusive != a_rhs.second.m_inclusive ?
+      a_lhs.second.m_inclusive > a_rhs.second.m_inclusive : a_lhs.first < a_rhs.first;
+  });
+
+  std::map<uint64_t, CallEdge> edges(a_graph.m_edges.begin(), a_graph.m_edges.end());
+  std::cerr << "Call graph profile (instructions):\n"
+    << std::right << std::setw(14) << "Inclusive" << std::setw(14) << "Exclusive" 
+    << std::setw(10) << "Calls" << "  Function\n";
+  for (const auto& [addr, func] : funcs) {
+    std::cerr << std::setw(14) << func.m_inclusive << std::setw(14) << func.m_exclusive
+      << std::setw(10) << func.m_calls << "  " << funcName(map, addr) << "\n";
+  }
+
+  for (const auto& [addr, func] : funcs) {
+    std::cerr << "\n" << funcName(map, addr) << "\n";
+    for (const auto& [key, edge] : edges) {
+      if (static_cast<uint32_t>(key) == addr) {
+        std::cerr << "  caller " << funcName(map, key >> 32) 
+          << "  calls " << edge.m_calls << "  instructions " << edge.m_instrs << "\n";
+      }
+    }
+    for (const auto& [key, edge] : edges) {
+      if ((key >> 32) == addr) {
+        std::cerr << "  callee " << funcName(map, static_cast<uint32_t>(key)) 
+          << "  calls " << edge.m_calls << "  instructions " << edge.m_instrs << "\n";
+      }
+    }
+  }
+  if (a_graph.m_untracked_calls > 0) {
+    std::cerr << "\n" << a_graph.m_untracked_calls << " calls deeper than " 
+      << MAX_SHADOW_DEPTH << " frames were not tracked\n";
+  }
+  std::cerr << std::flush;
+  return 0;
+}
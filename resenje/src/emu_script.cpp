@@ -0,0 +1,70 @@
+#include "../inc/emu_script.hpp"
+
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+bool parseKeys(const std::string& a_keys, uint64_t a_instr_cnt, std::vector<KeyEvent>& a_events) {
+  for (std::size_t i = 0; i < a_keys.size(); i++) {
+    char key = a_keys[i];
+    if (key == '\\') {
+      if (++i == a_keys.size()) {
+        return false;
+      }
+      switch (a_keys[i]) {
+        case 'n': key = '\n'; break;
+        case 'r': key = '\r'; break;
+        case 't': key = '\t'; break;
+        case 's': key = ' '; break;
+        case '\\': key = '\\'; break;
+        case 'x':
+          if (i + 2 >= a_keys.size() || !std::isxdigit(a_keys[i + 1]) || !std::isxdigit(a_keys[i + 2])) {
+            return false;
+          }
+          key = static_cast<char>(std::stoul(a_keys.substr(i + 1, 2), nullptr, 16));
+          i+= 2;
+          break;
+        default:
+          return false;
+      }
+    }
+    a_events.push_back(KeyEvent{a_instr_cnt, key});
+  }
+  return true;
+}
+
+bool parseKeyScript(const std::string& a_text, std::vector<KeyEvent>& a_keys) {
+  std::istringstream text(a_text);
+  std::string line;
+  uint64_t last_instr_cnt = 0;
+  for (uint32_t line_num = 1; std::getline(text, line); line_num++) {
+    std::istringstream fields(line);
+    std::string instr_cnt_str;
+    if (!(fields >> instr_cnt_str) || instr_cnt_str[0] == '#') {
+      continue;
+    }
+    std::string keys;
+    std::string extra;
+    fields >> keys;
+    uint64_t instr_cnt = 0;
+    if (!parseOptionNumber(instr_cnt_str, instr_cnt) || keys.empty() || (fields >> extra) || instr_cnt < last_instr_cnt || 
+        !parseKeys(keys, instr_cnt, a_keys)) {
+      std::cerr << "Greska: Neispravna linija " << line_num << " skripte ulaza: " << line << std::endl;
+      return false;
+    }
+    last_instr_cnt = instr_cnt;
+  }
+  return true;
+}
+
+bool loadKeyScript(const std::string& a_file, std::vector<KeyEvent>& a_keys) {
+  std::ifstream file(a_file);
+  if (!file.is_open()) {
+    std::cerr << "Greska prilikom otvaranja fajla: " << a_file << "\n";
+    return false;
+  }
+  std::ostringstream text;
+  text << file.rdbuf();
+  return parseKeyScript(text.str(), a_keys);
+}
@@ -0,0 +1,165 @@
+#include "../inc/emu_snapshot.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Fixed part of the header, the page address table follows it.
+struct SnapshotHeader {
+  char m_magic[4];
+  uint32_t m_version;
+  uint32_t m_page_cnt;
+  uint32_t m_gpr[GPR_NUM];
+  uint32_t m_csr[CSR_NUM];
+  uint64_t m_instr_cnt;
+  int32_t m_timer_config_ms;
+  uint32_t m_timer_virtual;
+  uint64_t m_timer_instrs_per_ms;
+  /// Instructions since the timer started in virtual time mode, wall clock
+  /// milliseconds otherwise.
+  uint64_t m_timer_elapsed;
+  uint32_t m_term_in;
+  uint32_t m_irq_pending;
+  uint32_t m_dma_regs[4];
+  /// Next key of the headless key script.
+  uint64_t m_input_pos;
+};
+
+std::size_t pageDataOffset(uint32_t a_page_cnt) {
+  std::size_t table_end = sizeof(SnapshotHeader) + a_page_cnt * sizeof(uint32_t);
+  return (table_end + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+}
+
+bool saveSnapshot(const Emulator& a_emulator, const std::string& a_file) {
+  std::vector<uint32_t> page_addrs;
+  std::vector<const Page*> pages;
+  forEachPage(a_emulator.m_mem32, [&] (uint32_t a_addr, const Page& a_page) {
+    page_addrs.push_back(a_addr);
+    pages.push_back(&a_page);
+  });
+
+  SnapshotHeader header{};
+  std::memcpy(header.m_magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  header.m_version = SNAPSHOT_VERSION;
+  header.m_page_cnt = static_cast<uint32_t>(pages.size());
+  std::memcpy(header.m_gpr, a_emulator.m_gpr, sizeof(header.m_gpr));
+  std::memcpy(header.m_csr, a_emulator.m_csr, sizeof(header.m_csr));
+  header.m_instr_cnt = a_emulator.m_instr_cnt;
+  const TimerState& timer = a_emulator.m_timer;
+  header.m_timer_config_ms = timer.m_config_ms;
+  header.m_timer_virtual = timer.m_virtual;
+  header.m_timer_instrs_per_ms = timer.m_instrs_per_ms;
+  if (timer.m_virtual) {
+    header.m_timer_elapsed = a_emulator.m_instr_cnt - timer.m_start_instr;
+  } else {
+    header.m_timer_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - timer.m_start_time
+    ).count();
+  }
+  header.m_term_in = a_emulator.m_terminal.m_in;
+  header.m_irq_pending = a_emulator.m_irq.m_pending;
+  const DmaState& dma = a_emulator.m_dma;
+  uint32_t dma_regs[] = {dma.m_src, dma.m_dst, dma.m_len, dma.m_status};
+  std::memcpy(header.m_dma_regs, dma_regs, sizeof(header.m_dma_regs));
+  header.m_input_pos = a_emulator.m_terminal.m_input_pos;
+
+  // the file may be the one this run was restored from and still back the
+  // guest pages, so it is only replaced once the new snapshot is complete
+  std::string tmp_file = a_file + ".tmp";
+  std::ofstream out(tmp_file, std::ios::binary);
+  if (!out.is_open()) {
+    return false;
+  }
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(page_addrs.data()), page_addrs.size() * sizeof(uint32_t));
+  std::size_t padding = pageDataOffset(header.m_page_cnt) - sizeof(header) - page_addrs.size() * sizeof(uint32_t);
+  std::vector<char> zeros(padding, 0);
+  out.write(zeros.data(), zeros.size());
+  for (const Page* page : pages) {
+    out.write(reinterpret_cast<const char*>(page->data()), PAGE_SIZE);
+  }
+  out.close();
+  if (!out.good() || std::rename(tmp_file.c_str(), a_file.c_str()) != 0) {
+    std::remove(tmp_file.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool restoreSnapshot(Emulator& a_emulator, const std::string& a_file) {
+  int fd = open(a_file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+    close(fd);
+    return false;
+  }
+  std::size_t size = static_cast<std::size_t>(st.st_size);
+  void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  GuestMemory& mem = a_emulator.m_mem32;
+  mem.m_mapping = data;
+  mem.m_mapping_size = size;
+
+  uint8_t* bytes = static_cast<uint8_t*>(data);
+  SnapshotHeader header;
+  std::memcpy(&header, bytes, sizeof(header));
+  if (std::memcmp(header.m_magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+      header.m_version != SNAPSHOT_VERSION ||
+      size < pageDataOffset(header.m_page_cnt) + static_cast<std::size_t>(header.m_page_cnt) * PAGE_SIZE) {
+    return false;
+  }
+  // the timer interrupts of the restored run have to come when they would
+  // have in the original one, so -vtime may only repeat the saved mode
+  TimerState& timer = a_emulator.m_timer;
+  if (timer.m_virtual && (header.m_timer_virtual == 0 || timer.m_instrs_per_ms != header.m_timer_instrs_per_ms)) {
+    std::cerr << "Greska: Opcija -vtime se ne slaze sa tajmerom iz snimka stanja" << std::endl;
+    return false;
+  }
+
+  const uint8_t* page_addrs = bytes + sizeof(header);
+  uint8_t* page_data = bytes + pageDataOffset(header.m_page_cnt);
+  for (uint32_t i = 0; i < header.m_page_cnt; i++) {
+    uint32_t addr;
+    std::memcpy(&addr, page_addrs + i * sizeof(uint32_t), sizeof(addr));
+    mapPage(mem, addr, reinterpret_cast<Page*>(page_data + static_cast<std::size_t>(i) * PAGE_SIZE));
+  }
+
+  std::memcpy(a_emulator.m_gpr, header.m_gpr, sizeof(header.m_gpr));
+  std::memcpy(a_emulator.m_csr, header.m_csr, sizeof(header.m_csr));
+  a_emulator.m_instr_cnt = header.m_instr_cnt;
+  timer.m_config_ms = header.m_timer_config_ms;
+  timer.m_virtual = header.m_timer_virtual != 0;
+  timer.m_instrs_per_ms = header.m_timer_instrs_per_ms;
+  if (timer.m_virtual) {
+    timer.m_start_instr = header.m_instr_cnt - header.m_timer_elapsed;
+  } else {
+    timer.m_start_time = std::chrono::steady_clock::now() - std::chrono::milliseconds(header.m_timer_elapsed);
+  }
+  a_emulator.m_terminal.m_in = header.m_term_in;
+  a_emulator.m_terminal.m_input_pos = static_cast<std::size_t>(header.m_input_pos);
+  a_emulator.m_irq.m_pending = header.m_irq_pending;
+  DmaState& dma = a_emulator.m_dma;
+  dma.m_src = header.m_dma_regs[0];
+  dma.m_dst = header.m_dma_regs[1];
+  dma.m_len = header.m_dma_regs[2];
+  dma.m_status = header.m_dma_regs[3];
+  return true;
+}
+
+bool isSnapshotFile(const std::string& a_file) {
+  std::ifstream file(a_file, std::ios::binary);
+  char magic[sizeof(SNAPSHOT_MAGIC)];
+  return file.read(magic, sizeof(magic)) && std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+}
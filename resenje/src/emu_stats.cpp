@@ -0,0 +1,219 @@
+#include "../inc/emu_stats.hpp"
+#include "../inc/emu_interrupts.hpp"
+#include "../inc/instructions.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+uint32_t instrKind(uint8_t a_oc, uint8_t a_mod) {
+  return (a_oc << 4) | a_mod;
+}
+
+std::string instrName(uint32_t a_kind) {
+  uint8_t oc = a_kind >> 4;
+  uint8_t mod = a_kind & 0xF;
+  switch (oc) {
+    case OpCode::HALT: return "halt";
+    case OpCode::INT: return "int";
+    case OpCode::XCHG: return "xchg";
+    case OpCode::CALL:
+      switch (mod) {
+        case CallMod::CALL_PC_REL: return "call";
+        case CallMod::CALL_MEM_REL: return "call_mem";
+      }
+      break;
+    case OpCode::JMP:
+      switch (mod) {
+        case JmpMod::JMP_PC_REL: return "jmp";
+        case JmpMod::BEQ_PC_REL: return "beq";
+        case JmpMod::BNE_PC_REL: return "bne";
+        case JmpMod::BGT_PC_REL: return "bgt";
+        case JmpMod::JMP_MEM_REL: return "jmp_mem";
+        case JmpMod::BEQ_MEM_REL: return "beq_mem";
+        case JmpMod::BNE_MEM_REL: return "bne_mem";
+        case JmpMod::BGT_MEM_REL: return "bgt_mem";
+      }
+      break;
+    case OpCode::ARITHMETIC:
+      switch (mod) {
+        case ArithmeticMod::ADD: return "add";
+        case ArithmeticMod::SUB: return "sub";
+        case ArithmeticMod::MUL: return "mul";
+        case ArithmeticMod::DIV: return "div";
+      }
+      break;
+    case OpCode::LOGIC:
+      switch (mod) {
+        case LogicMod::NOT: return "not";
+        case LogicMod::AND: return "and";
+        case LogicMod::OR: return "or";
+        case LogicMod::XOR: return "xor";
+      }
+      break;
+    case OpCode::SHIFT:
+      switch (mod) {
+        case ShiftMod::SHL: return "shl";
+        case ShiftMod::SHR: return "shr";
+      }
+      break;
+    case OpCode::ST:
+      switch (mod) {
+        case StMod::MEM_REL: return "st_mem";
+        case StMod::MEM_IND_DISP: return "st_push";
+        case StMod::MEM_IND: return "st_mem_ind";
+      }
+      break;
+    case OpCode::LD:
+      switch (mod) {
+        case LdMod::GPR_DIR: return "csrrd";
+        case LdMod::GPR_PC_REL: return "ld_gpr";
+        case LdMod::GPR_MEM_IND: return "ld_mem";
+        case LdMod::GPR_MEM_IND_DISP: return "ld_pop";
+        case LdMod::CSR_DIR: return "csrwr";
+        case LdMod::CSR_PC_REL: return "ld_csr";
+        case LdMod::CSR_MEM_IND: return "ld_csr_mem";
+        case LdMod::CSR_MEM_IND_DISP: return "ld_csr_pop";
+      }
+      break;
+  }
+  std::ostringstream name;
+  name << "unknown_" << std::hex << a_kind;
+  return name.str();
+}
+
+/// Data words read by each instruction kind. Conditional branches through
+/// memory only read their target when taken.
+uint64_t memLoads(const EmulatorStats& a_stats) {
+  const auto& hist = a_stats.m_instr_hist;
+  const auto& taken = a_stats.m_taken_hist;
+  return hist[instrKind(OpCode::CALL, CallMod::CALL_MEM_REL)] +
+    hist[instrKind(OpCode::JMP, JmpMod::JMP_MEM_REL)] +
+    taken[instrKind(OpCode::JMP, JmpMod::BEQ_MEM_REL)] +
+    taken[instrKind(OpCode::JMP, JmpMod::BNE_MEM_REL)] +
+    taken[instrKind(OpCode::JMP, JmpMod::BGT_MEM_REL)] +
+    hist[instrKind(OpCode::ST, StMod::MEM_IND)] +
+    hist[instrKind(OpCode::LD, LdMod::GPR_MEM_IND)] +
+    hist[instrKind(OpCode::LD, LdMod::GPR_MEM_IND_DISP)] +
+    hist[instrKind(OpCode::LD, LdMod::CSR_MEM_IND)] +
+    hist[instrKind(OpCode::LD, LdMod::CSR_MEM_IND_DISP)];
+}
+
+uint64_t softwareInterrupts(const EmulatorStats& a_stats) {
+  uint64_t cnt = 0;
+  for (uint8_t mod = 0; mod < 16; mod++) {
+    cnt+= a_stats.m_instr_hist[instrKind(OpCode::INT, mod)];
+  }
+  return cnt;
+}
+
+/// Interrupts, hardware and software alike, push status and pc.
+uint64_t memStores(const EmulatorStats& a_stats) {
+  const auto& hist = a_stats.m_instr_hist;
+  return 2 * (softwareInterrupts(a_stats) + 
+      a_stats.m_interrupts[CAUSE_TIMER] + a_stats.m_interrupts[CAUSE_TERMINAL] + 
+      a_stats.m_interrupts[CAUSE_DMA]) +
+    hist[instrKind(OpCode::CALL, CallMod::CALL_PC_REL)] +
+    hist[instrKind(OpCode::CALL, CallMod::CALL_MEM_REL)] +
+    hist[instrKind(OpCode::ST, StMod::MEM_REL)] +
+    hist[instrKind(OpCode::ST, StMod::MEM_IND_DISP)] +
+    hist[instrKind(OpCode::ST, StMod::MEM_IND)];
+}
+
+/// Executed instruction kinds, most frequent first.
+std::vector<uint32_t> sortedKinds(const EmulatorStats& a_stats) {
+  std::vector<uint32_t> kinds;
+  for (uint32_t kind = 0; kind < INSTR_KIND_NUM; kind++) {
+    if (a_stats.m_instr_hist[kind] != 0) {
+      kinds.push_back(kind);
+    }
+  }
+  std::stable_sort(kinds.begin(), kinds.end(), [&a_stats] (uint32_t a_lhs, uint32_t a_rhs) {
+    return a_stats.m_instr_hist[a_lhs] > a_stats.m_instr_hist[a_rhs];
+  });
+  return kinds;
+}
+
+void showStatsText(
+  const EmulatorStats& a_stats, 
+  const char* a_engine, 
+  uint64_t a_instr_cnt, 
+  double a_seconds
+) {
+  std::ostream& out = std::cerr;
+  out << "Dispatch engine: " << a_engine << "\n"
+    << "Executed instructions: " << a_instr_cnt << "\n"
+    << "Elapsed time: " << std::fixed << std::setprecision(3) << a_seconds << " s\n"
+    << "MIPS: " << std::setprecision(2) << (a_seconds > 0 ? a_instr_cnt / a_seconds / 1e6 : 0.0) << "\n"
+    << "Memory loads: " << memLoads(a_stats) << "\n"
+    << "Memory stores: " << memStores(a_stats) << "\n"
+    << "MMIO reads: " << a_stats.m_mmio_reads << "\n"
+    << "MMIO writes: " << a_stats.m_mmio_writes << "\n"
+    << "Timer interrupts: " << a_stats.m_interrupts[CAUSE_TIMER] << "\n"
+    << "Terminal interrupts: " << a_stats.m_interrupts[CAUSE_TERMINAL] << "\n"
+    << "Software interrupts: " << softwareInterrupts(a_stats) << "\n"
+    << "DMA interrupts: " << a_stats.m_interrupts[CAUSE_DMA] << "\n"
+    << "Instruction histogram:\n";
+  for (uint32_t kind : sortedKinds(a_stats)) {
+    uint64_t cnt = a_stats.m_instr_hist[kind];
+    out << "  " << std::left << std::setw(12) << instrName(kind) << std::right 
+      << std::setw(14) << cnt << std::setw(8) << std::setprecision(2) 
+      << 100.0 * cnt / std::max<uint64_t>(a_instr_cnt, 1) << "%";
+    if ((kind >> 4) == OpCode::JMP) {
+      out << "  taken " << a_stats.m_taken_hist[kind];
+    }
+    out << "\n";
+  }
+  out << std::flush;
+}
+
+void showStatsJson(
+  const EmulatorStats& a_stats, 
+  const char* a_engine, 
+  uint64_t a_instr_cnt, 
+  double a_seconds
+) {
+  std::ostream& out = std::cerr;
+  out << "{\"engine\": \"" << a_engine << "\""
+    << ", \"instructions\": " << a_instr_cnt
+    << ", \"seconds\": " << std::fixed << std::setprecision(6) << a_seconds
+    << ", \"mips\": " << std::setprecision(3) << (a_seconds > 0 ? a_instr_cnt / a_seconds / 1e6 : 0.0)
+    << ", \"loads\": " << memLoads(a_stats)
+    << ", \"stores\": " << memStores(a_stats)
+    << ", \"mmio_reads\": " << a_stats.m_mmio_reads
+    << ", \"mmio_writes\": " << a_stats.m_mmio_writes
+    << ", \"interrupts\": {\"timer\": " << a_stats.m_interrupts[CAUSE_TIMER]
+    << ", \"terminal\": " << a_stats.m_interrupts[CAUSE_TERMINAL]
+    << ", \"software\": " << softwareInterrupts(a_stats)
+    << ", \"dma\": " << a_stats.m_interrupts[CAUSE_DMA] << "}"
+    << ", \"histogram\": {";
+  const char* sep = "";
+  for (uint32_t kind : sortedKinds(a_stats)) {
+    out << sep << "\"" << instrName(kind) << "\": " << a_stats.m_instr_hist[kind];
+    sep = ", ";
+  }
+  out << "}, \"taken\": {";
+  sep = "";
+  for (uint32_t kind : sortedKinds(a_stats)) {
+    if ((kind >> 4) == OpCode::JMP) {
+      out << sep << "\"" << instrName(kind) << "\": " << a_stats.m_taken_hist[kind];
+      sep = ", ";
+    }
+  }
+  out << "}}" << std::endl;
+}
+
+void showStats(
+  const EmulatorStats& a_stats, 
+  const char* a_engine, 
+  uint64_t a_instr_cnt, 
+  double a_seconds
+) {
+  if (a_stats.m_json) {
+    showStatsJson(a_stats, a_engine, a_instr_cnt, a_seconds);
+  } else {
+    showStatsText(a_stats, a_engine, a_instr_cnt, a_seconds);
+  }
+}
@@ -1,12 +1,41 @@
 #include "../inc/emu_terminal.hpp"
+#include "../inc/spsc_queue.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <errno.h>
 #include <fcntl.h>
+#include <mutex>
+#include <poll.h>
 #include <stdlib.h>
 #include <termios.h>
+#include <thread>
 #include <unistd.h>
 
 struct termios initial_term_state;
 
+/// Characters typed on the terminal, filled by the reader thread and drained
+/// by the emulator loop without any system call on its side.
+SpscQueue<char, 1024> term_input_queue;
+std::atomic<bool> term_reader_running{false};
+std::thread term_reader;
+/// Lets an idle emulator sleep until the reader thread has queued input.
+std::mutex term_input_lock;
+std::condition_variable term_input_ready;
+
+const int TERM_READER_POLL_MS = 50;
+
+/// Guest output is collected here and handed to the kernel with one write()
+/// on a newline, when the buffer fills up, at halt, or once the oldest
+/// buffered character has waited TERM_OUT_FLUSH_BUDGET.
+const std::size_t TERM_OUT_BUF_SIZE = 4096;
+const auto TERM_OUT_FLUSH_BUDGET = std::chrono::milliseconds(20);
+char term_out_buf[TERM_OUT_BUF_SIZE];
+std::size_t term_out_len = 0;
+int term_out_fd = STDOUT_FILENO;
+std::chrono::steady_clock::time_point term_out_first_time;
+
 void resetTerminal() {
   tcsetattr(STDIN_FILENO,TCSANOW, &initial_term_state);
 }
@@ -23,4 +52,94 @@ void initTerminal() {
 
   int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
   fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
-}
\ No newline at end of file
+}
+
+void readTerminalInput() {
+  pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+  char buf[64];
+  while (term_reader_running.load(std::memory_order_relaxed)) {
+    if (poll(&pfd, 1, TERM_READER_POLL_MS) <= 0) {
+      continue;
+    }
+    ssize_t cnt = read(STDIN_FILENO, buf, sizeof(buf));
+    if (cnt == 0 || (cnt < 0 && errno != EAGAIN && errno != EINTR)) {
+      break;
+    }
+    for (ssize_t i = 0; i < cnt; i++) {
+      while (!term_input_queue.push(buf[i])) {
+        if (!term_reader_running.load(std::memory_order_relaxed)) {
+          return;
+        }
+        std::this_thread::yield();
+      }
+    }
+    {
+      std::lock_guard<std::mutex> guard(term_input_lock);
+    }
+    term_input_ready.notify_one();
+  }
+}
+
+void startTerminalReader() {
+  term_reader_running = true;
+  term_reader = std::thread(readTerminalInput);
+}
+
+void stopTerminalReader() {
+  term_reader_running = false;
+  if (term_reader.joinable()) {
+    term_reader.join();
+  }
+}
+
+bool readTerminalChar(char& a_c) {
+  return term_input_queue.pop(a_c);
+}
+
+bool waitTerminalInput(std::chrono::steady_clock::time_point a_deadline) {
+  std::unique_lock<std::mutex> guard(term_input_lock);
+  return term_input_ready.wait_until(guard, a_deadline, [] {
+    return !term_input_queue.empty();
+  });
+}
+
+bool openTerminalOutput(const std::string& a_output_file) {
+  int fd = open(a_output_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  term_out_fd = fd;
+  return true;
+}
+
+void flushTerminalOutput() {
+  std::size_t written = 0;
+  while (written < term_out_len) {
+    ssize_t cnt = write(term_out_fd, term_out_buf + written, term_out_len - written);
+    if (cnt < 0) {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      break;
+    }
+    written+= cnt;
+  }
+  term_out_len = 0;
+}
+
+void writeTerminalChar(char a_c) {
+  if (term_out_len == 0) {
+    term_out_first_time = std::chrono::steady_clock::now();
+  }
+  term_out_buf[term_out_len++] = a_c;
+  if (a_c == '\n' || term_out_len == TERM_OUT_BUF_SIZE) {
+    flushTerminalOutput();
+  }
+}
+
+void flushTerminalOutputIfDue() {
+  if (term_out_len != 0 && 
+      std::chrono::steady_clock::now() - term_out_first_time >= TERM_OUT_FLUSH_BUDGET) {
+    flushTerminalOutput();
+  }
+}
@@ -0,0 +1,421 @@
+#include "../inc/emu_trace.hpp"
+#include "../inc/emu_interrupts.hpp"
+#include "../inc/image.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+const auto TRACE_WRITER_IDLE = std::chrono::milliseconds(1);
+
+void writeTraceChunks(TraceWriter& a_writer) {
+  while (true) {
+    TraceChunk* chunk;
+    if (!a_writer.m_full_chunks.pop(chunk)) {
+      if (!a_writer.m_running.load(std::memory_order_acquire) && a_writer.m_full_chunks.empty()) {
+        return;
+      }
+      std::this_thread::sleep_for(TRACE_WRITER_IDLE);
+      continue;
+    }
+    std::size_t written = 0;
+    while (!a_writer.m_failed && written < chunk->size()) {
+      ssize_t cnt = write(a_writer.m_fd, chunk->data() + written, chunk->size() - written);
+      if (cnt < 0 && errno == EINTR) {
+        continue;
+      }
+      if (cnt <= 0) {
+        a_writer.m_failed = true;
+        break;
+      }
+      written+= cnt;
+    }
+    chunk->clear();
+    a_writer.m_free_chunks.push(chunk);
+  }
+}
+
+void submitTraceChunk(TraceWriter& a_writer) {
+  while (!a_writer.m_full_chunks.push(a_writer.m_chunk)) {
+    std::this_thread::yield();
+  }
+  while (!a_writer.m_free_chunks.pop(a_writer.m_chunk)) {
+    std::this_thread::yield();
+  }
+}
+
+inline void traceByte(TraceWriter& a_writer, uint8_t a_byte) {
+  a_writer.m_chunk->push_back(a_byte);
+}
+
+void traceWord(TraceWriter& a_writer, uint32_t a_word) {
+  uint8_t bytes[4];
+  writeLe32(bytes, a_word);
+  a_writer.m_chunk->insert(a_writer.m_chunk->end(), bytes, bytes + 4);
+}
+
+void traceVarint(TraceWriter& a_writer, uint64_t a_val) {
+  while (a_val >= 0x80) {
+    traceByte(a_writer, static_cast<uint8_t>(a_val | 0x80));
+    a_val>>= 7;
+  }
+  traceByte(a_writer, static_cast<uint8_t>(a_val));
+}
+
+uint32_t zigzag(int32_t a_val) {
+  return (static_cast<uint32_t>(a_val) << 1) ^ static_cast<uint32_t>(a_val >> 31);
+}
+
+int32_t unzigzag(uint32_t a_val) {
+  return static_cast<int32_t>(a_val >> 1) ^ -static_cast<int32_t>(a_val & 1);
+}
+
+bool startTraceWriter(TraceState& a_trace) {
+  TraceWriter& writer = a_trace.m_writer;
+  writer.m_fd = open(a_trace.m_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (writer.m_fd < 0) {
+    return false;
+  }
+  for (std::size_t i = 0; i < TRACE_CHUNK_NUM; i++) {
+    writer.m_chunks.push_back(std::make_unique<TraceChunk>());
+    writer.m_chunks.back()->reserve(TRACE_CHUNK_SIZE + 64);
+    if (i > 0) {
+      writer.m_free_chunks.push(writer.m_chunks.back().get());
+    }
+  }
+  writer.m_chunk = writer.m_chunks.front().get();
+
+  writer.m_chunk->insert(writer.m_chunk->end(), TRACE_MAGIC, TRACE_MAGIC + sizeof(TRACE_MAGIC));
+  traceWord(writer, TRACE_VERSION);
+
+  writer.m_running = true;
+  writer.m_thread = std::thread(writeTraceChunks, std::ref(writer));
+  return true;
+}
+
+/// True when a_pc still maps to a_word in the word cache, refreshes it
+/// otherwise.
+bool cachedWord(TraceCursor& a_cursor, uint32_t a_pc, uint32_t a_word) {
+  std::size_t slot = (a_pc / 4) % TRACE_WORD_CACHE_SIZE;
+  if (a_cursor.m_word_valid[slot] && a_cursor.m_word_pcs[slot] == a_pc &&
+      a_cursor.m_words[slot] == a_word) {
+    return true;
+  }
+  a_cursor.m_word_valid.set(slot);
+  a_cursor.m_word_pcs[slot] = a_pc;
+  a_cursor.m_words[slot] = a_word;
+  return false;
+}
+
+void traceInstr(TraceState& a_trace, const TraceRegs& a_regs) {
+  TraceWriter& writer = a_trace.m_writer;
+  TraceCursor& cursor = a_trace.m_cursor;
+  const TraceInstr& instr = a_trace.m_instr;
+
+  uint8_t reg_cnt = 0;
+  for (std::size_t reg = 0; reg < TRACE_REG_NUM; reg++) {
+    if (reg != TRACE_PC_REG && a_regs[reg] != cursor.m_regs[reg]) {
+      reg_cnt++;
+    }
+  }
+
+  uint8_t tag = TRACE_INSTR;
+  if (instr.m_pc != cursor.m_next_pc) {
+    tag|= TRACE_PC_JUMP;
+  }
+  if (!cachedWord(cursor, instr.m_pc, instr.m_word)) {
+    tag|= TRACE_INSTR_WORD;
+  }
+  if (reg_cnt > 0) {
+    tag|= TRACE_REG_WRITES;
+  }
+  if (instr.m_mem_write_cnt > 0) {
+    tag|= TRACE_MEM_WRITES;
+  }
+
+  traceByte(writer, tag);
+  if (tag & TRACE_PC_JUMP) {
+    traceVarint(writer, zigzag(static_cast<int32_t>(instr.m_pc - cursor.m_next_pc)));
+  }
+  if (tag & TRACE_INSTR_WORD) {
+    traceWord(writer, instr.m_word);
+  }
+  if (tag & TRACE_REG_WRITES) {
+    traceByte(writer, reg_cnt);
+    for (std::size_t reg = 0; reg < TRACE_REG_NUM; reg++) {
+      if (reg != TRACE_PC_REG && a_regs[reg] != cursor.m_regs[reg]) {
+        traceByte(writer, static_cast<uint8_t>(reg));
+        traceVarint(writer, a_regs[reg]);
+        cursor.m_regs[reg] = a_regs[reg];
+      }
+    }
+  }
+  if (tag & TRACE_MEM_WRITES) {
+    traceByte(writer, instr.m_mem_write_cnt);
+    for (uint8_t i = 0; i < instr.m_mem_write_cnt; i++) {
+      traceWord(writer, instr.m_mem_writes[i].m_addr);
+      traceWord(writer, instr.m_mem_writes[i].m_val);
+    }
+  }
+  cursor.m_next_pc = instr.m_pc + 4;
+
+  if (writer.m_chunk->size() >= TRACE_CHUNK_SIZE) {
+    submitTraceChunk(writer);
+  }
+}
+
+void traceInterrupt(TraceState& a_trace, const TraceEvent& a_event) {
+  TraceWriter& writer = a_trace.m_writer;
+  traceByte(writer, TRACE_INTERRUPT);
+  traceByte(writer, a_event.m_cause);
+  traceWord(writer, a_event.m_term_in);
+  traceVarint(writer, a_event.m_instr_cnt);
+}
+
+bool stopTraceWriter(TraceState& a_trace, uint64_t a_instr_cnt) {
+  TraceWriter& writer = a_trace.m_writer;
+  traceByte(writer, TRACE_END);
+  traceVarint(writer, a_instr_cnt);
+  while (!writer.m_full_chunks.push(writer.m_chunk)) {
+    std::this_thread::yield();
+  }
+  writer.m_running.store(false, std::memory_order_release);
+  writer.m_thread.join();
+  if (close(writer.m_fd) != 0) {
+    writer.m_failed = true;
+  }
+  writer.m_fd = -1;
+  if (writer.m_failed) {
+    std::cerr << "Greska prilikom pisanja fajla: " << a_trace.m_file << "\n";
+    return false;
+  }
+  return true;
+}
+
+/// One decoded record of either kind.
+struct TraceRecord {
+  uint8_t m_tag = 0;
+  int32_t m_pc_delta = 0;
+  uint32_t m_word = 0;
+  uint8_t m_reg_cnt = 0;
+  std::array<uint8_t, TRACE_REG_NUM> m_reg_ndx;
+  TraceRegs m_reg_vals;
+  uint8_t m_mem_write_cnt = 0;
+  std::array<TraceMemWrite, TRACE_MAX_MEM_WRITES> m_mem_writes;
+  TraceEvent m_event;
+};
+
+bool readTraceWord(const std::vector<uint8_t>& a_data, std::size_t& a_pos, uint32_t& a_word) {
+  if (a_data.size() - a_pos < 4) {
+    return false;
+  }
+  a_word = readLe32(a_data.data() + a_pos);
+  a_pos+= 4;
+  return true;
+}
+
+bool readTraceVarint(const std::vector<uint8_t>& a_data, std::size_t& a_pos, uint64_t& a_val) {
+  a_val = 0;
+  for (uint32_t shift = 0; shift < 64 && a_pos < a_data.size(); shift+= 7) {
+    uint8_t byte = a_data[a_pos++];
+    a_val|= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool readTraceRecord(const std::vector<uint8_t>& a_data, std::size_t& a_pos, TraceRecord& a_rec) {
+  if (a_pos >= a_data.size()) {
+    return false;
+  }
+  a_rec.m_tag = a_data[a_pos++];
+  uint64_t val;
+  if (a_rec.m_tag == TRACE_END) {
+    if (!readTraceVarint(a_data, a_pos, val)) {
+      return false;
+    }
+    a_rec.m_event.m_instr_cnt = val;
+    return true;
+  }
+  if (a_rec.m_tag == TRACE_INTERRUPT) {
+    if (a_pos >= a_data.size()) {
+      return false;
+    }
+    a_rec.m_event.m_cause = a_data[a_pos++];
+    if (!isIrqCause(a_rec.m_event.m_cause)) {
+      return false;
+    }
+    if (!readTraceWord(a_data, a_pos, a_rec.m_event.m_term_in) ||
+        !readTraceVarint(a_data, a_pos, val)) {
+      return false;
+    }
+    a_rec.m_event.m_instr_cnt = val;
+    return true;
+  }
+  if (a_rec.m_tag & ~(TRACE_PC_JUMP | TRACE_INSTR_WORD | TRACE_REG_WRITES | TRACE_MEM_WRITES)) {
+    return false;
+  }
+
+  a_rec.m_pc_delta = 0;
+  if (a_rec.m_tag & TRACE_PC_JUMP) {
+    if (!readTraceVarint(a_data, a_pos, val)) {
+      return false;
+    }
+    a_rec.m_pc_delta = unzigzag(static_cast<uint32_t>(val));
+  }
+  if ((a_rec.m_tag & TRACE_INSTR_WORD) && !readTraceWord(a_data, a_pos, a_rec.m_word)) {
+    return false;
+  }
+  a_rec.m_reg_cnt = 0;
+  if (a_rec.m_tag & TRACE_REG_WRITES) {
+    if (a_pos >= a_data.size() || a_data[a_pos] > TRACE_REG_NUM) {
+      return false;
+    }
+    a_rec.m_reg_cnt = a_data[a_pos++];
+    for (uint8_t i = 0; i < a_rec.m_reg_cnt; i++) {
+      if (a_pos >= a_data.size() || a_data[a_pos] >= TRACE_REG_NUM) {
+        return false;
+      }
+      a_rec.m_reg_ndx[i] = a_data[a_pos++];
+      if (!readTraceVarint(a_data, a_pos, val)) {
+        return false;
+      }
+      a_rec.m_reg_vals[i] = static_cast<uint32_t>(val);
+    }
+  }
+  a_rec.m_mem_write_cnt = 0;
+  if (a_rec.m_tag & TRACE_MEM_WRITES) {
+    if (a_pos >= a_data.size() || a_data[a_pos] > TRACE_MAX_MEM_WRITES) {
+      return false;
+    }
+    a_rec.m_mem_write_cnt = a_data[a_pos++];
+    for (uint8_t i = 0; i < a_rec.m_mem_write_cnt; i++) {
+      if (!readTraceWord(a_data, a_pos, a_rec.m_mem_writes[i].m_addr) ||
+          !readTraceWord(a_data, a_pos, a_rec.m_mem_writes[i].m_val)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// Reads the whole trace and collects its interrupts up front, they have to
+/// be delivered before the instruction records around them are checked.
+bool loadTrace(TraceState& a_trace) {
+  std::ifstream in(a_trace.m_file, std::ios::binary);
+  if (!in.is_open()) {
+    std::cerr << "Greska prilikom otvaranja fajla: " << a_trace.m_file << "\n";
+    return false;
+  }
+  a_trace.m_data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  if (a_trace.m_data.size() < TRACE_HEADER_SIZE ||
+      std::memcmp(a_trace.m_data.data(), TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+      readLe32(a_trace.m_data.data() + 4) != TRACE_VERSION) {
+    std::cerr << "Greska: Neispravno zaglavlje traga" << std::endl;
+    return false;
+  }
+
+  std::size_t pos = TRACE_HEADER_SIZE;
+  TraceRecord rec;
+  while (true) {
+    if (!readTraceRecord(a_trace.m_data, pos, rec)) {
+      std::cerr << "Greska: Trag je neispravan ili skracen" << std::endl;
+      return false;
+    }
+    if (rec.m_tag == TRACE_END) {
+      break;
+    }
+    if (rec.m_tag == TRACE_INTERRUPT) {
+      a_trace.m_events.push_back(rec.m_event);
+    }
+  }
+  a_trace.m_pos = TRACE_HEADER_SIZE;
+  return true;
+}
+
+void diverge(TraceState& a_trace, uint64_t a_instr_cnt, const std::string& a_reason) {
+  std::ostringstream msg;
+  msg << "Greska: Izvrsavanje se razlikuje od traga kod instrukcije " << a_instr_cnt
+    << " (pc 0x" << std::hex << a_trace.m_instr.m_pc << "): " << a_reason;
+  a_trace.m_diverged = true;
+  a_trace.m_divergence = msg.str();
+}
+
+/// Reads the next instruction record and compares it with the instruction
+/// that just finished.
+void replayInstr(TraceState& a_trace, const TraceRegs& a_regs, uint64_t a_instr_cnt) {
+  if (a_trace.m_diverged) {
+    return;
+  }
+  TraceCursor& cursor = a_trace.m_cursor;
+  const TraceInstr& instr = a_trace.m_instr;
+
+  TraceRecord rec;
+  do {
+    readTraceRecord(a_trace.m_data, a_trace.m_pos, rec);
+  } while (rec.m_tag == TRACE_INTERRUPT);
+  if (rec.m_tag == TRACE_END) {
+    diverge(a_trace, a_instr_cnt, "trag je zavrsen");
+    return;
+  }
+
+  uint32_t pc = cursor.m_next_pc + rec.m_pc_delta;
+  cursor.m_next_pc = pc + 4;
+  if (pc != instr.m_pc) {
+    diverge(a_trace, a_instr_cnt, "pc");
+    return;
+  }
+  if (rec.m_tag & TRACE_INSTR_WORD) {
+    cachedWord(cursor, pc, rec.m_word);
+  }
+  std::size_t slot = (pc / 4) % TRACE_WORD_CACHE_SIZE;
+  if (!cursor.m_word_valid[slot] || cursor.m_word_pcs[slot] != pc || cursor.m_words[slot] != instr.m_word) {
+    diverge(a_trace, a_instr_cnt, "instrukcija");
+    return;
+  }
+  for (uint8_t i = 0; i < rec.m_reg_cnt; i++) {
+    cursor.m_regs[rec.m_reg_ndx[i]] = rec.m_reg_vals[i];
+  }
+  for (std::size_t reg = 0; reg < TRACE_REG_NUM; reg++) {
+    if (reg != TRACE_PC_REG && cursor.m_regs[reg] != a_regs[reg]) {
+      diverge(a_trace, a_instr_cnt, "registar " + std::to_string(reg));
+      return;
+    }
+  }
+  if (rec.m_mem_write_cnt != instr.m_mem_write_cnt) {
+    diverge(a_trace, a_instr_cnt, "upis u memoriju");
+    return;
+  }
+  for (uint8_t i = 0; i < rec.m_mem_write_cnt; i++) {
+    if (rec.m_mem_writes[i].m_addr != instr.m_mem_writes[i].m_addr ||
+        rec.m_mem_writes[i].m_val != instr.m_mem_writes[i].m_val) {
+      diverge(a_trace, a_instr_cnt, "upis u memoriju");
+      return;
+    }
+  }
+}
+
+void finishReplay(TraceState& a_trace, uint64_t a_instr_cnt) {
+  if (a_trace.m_diverged) {
+    return;
+  }
+  TraceRecord rec;
+  do {
+    readTraceRecord(a_trace.m_data, a_trace.m_pos, rec);
+  } while (rec.m_tag == TRACE_INTERRUPT);
+  if (rec.m_tag != TRACE_END || rec.m_event.m_instr_cnt != a_instr_cnt) {
+    diverge(a_trace, a_instr_cnt, "program je zavrsen pre kraja traga");
+  }
+}
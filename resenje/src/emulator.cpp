@@ -1,18 +1,38 @@
 #include "../inc/emulator.hpp"
+#include "../inc/emu_batch.hpp"
+#include "../inc/emu_loader.hpp"
+#include "../inc/emu_snapshot.hpp"
 #include "../inc/emu_terminal.hpp"
 #include "../inc/instructions.hpp"
+#include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
-#include <sstream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <sys/resource.h>
 
-Emulator emulator;
+thread_local Emulator* emulator = nullptr;
 const uint32_t term_out = 0xFFFFFF00;
 const uint32_t term_in = 0xFFFFFF04;
 const uint32_t tim_cfg = 0xFFFFFF10;
+const uint32_t dma_src = 0xFFFFFF20;
+const uint32_t dma_dst = 0xFFFFFF24;
+const uint32_t dma_len = 0xFFFFFF28;
+const uint32_t dma_ctrl = 0xFFFFFF2C;
+
+/// Written to dma_ctrl: the operation, optionally with a completion
+/// interrupt. A fill stores the low byte of dma_src. dma_ctrl reads back
+/// the status of the last transfer.
+const uint32_t DMA_OP_MASK = 0x00000003;
+const uint32_t DMA_OP_COPY = 0x00000001;
+const uint32_t DMA_OP_FILL = 0x00000002;
+const uint32_t DMA_CTRL_IRQ = 0x00000004;
+const uint32_t DMA_STATUS_DONE = 0x00000001;
+const uint32_t DMA_STATUS_ERROR = 0x00000002;
 
 const uint32_t TIMER_MASK = 0x00000001;
 const uint32_t TERMINAL_MASK = 0x00000002;
@@ -29,63 +49,237 @@ std::unordered_map<uint32_t, uint32_t> timer_config_map = {
   {0x7, 60000}
 };
 
-int32_t handleArguments(int argc, char* argv[], std::string& a_input_file) {
-  if (argc != 2) {
+/// Instructions per virtual millisecond when -vtime is given without a value.
+const uint64_t DEFAULT_INSTRS_PER_MS = 100000;
+const std::size_t VTIME_ARG_OFF = 7;
+const std::size_t TERM_OUT_ARG_OFF = 10;
+const std::size_t PROFILE_INTERVAL_ARG_OFF = 19;
+const std::size_t SYMTAB_ARG_OFF = 9;
+const std::size_t FOLDED_ARG_OFF = 9;
+const std::size_t TRACE_ARG_OFF = 8;
+const std::size_t REPLAY_ARG_OFF = 9;
+const std::size_t SNAPSHOT_ARG_OFF = 11;
+const std::size_t SNAPSHOT_AT_ARG_OFF = 14;
+const std::size_t RESTORE_ARG_OFF = 10;
+const std::size_t BATCH_ARG_OFF = 8;
+const std::size_t BATCH_OUT_ARG_OFF = 12;
+const std::size_t JOBS_ARG_OFF = 7;
+const std::size_t INPUT_ARG_OFF = 8;
+const std::size_t OUTPUT_ARG_OFF = 9;
+
+/// Options of the run go straight into the emulator, --batch=<list> copies
+/// them into a_batch_config for every program of the list.
+int32_t handleArguments(
+  int argc, char* argv[], std::string& a_input_file, std::string& a_restore_file,
+  BatchConfig& a_batch_config, bool& a_bench_mode
+) {
+  std::string term_out_file;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = std::string(argv[i]);
+    if (arg == "-bench") {
+      a_bench_mode = true;
+    } else if (arg == "--stats") {
+      emulator->m_stats.m_enabled = true;
+    } else if (arg == "--stats=json") {
+      emulator->m_stats.m_enabled = true;
+      emulator->m_stats.m_json = true;
+    } else if (arg == "--profile") {
+      emulator->m_profiler.m_enabled = true;
+    } else if (arg.find("--profile-interval=") == 0) {
+      emulator->m_profiler.m_enabled = true;
+      if (!parseOptionNumber(arg.substr(PROFILE_INTERVAL_ARG_OFF), emulator->m_profiler.m_interval)) {
+        std::cerr << "Greska: Neispravna vrednost opcije: " << arg << std::endl;
+        return 1;
+      }
+      emulator->m_profiler.m_countdown = emulator->m_profiler.m_interval;
+      if (emulator->m_profiler.m_interval == 0) {
+        std::cerr << "Greska: Interval uzorkovanja mora biti pozitivan" << std::endl;
+        return 1;
+      }
+    } else if (arg == "--callgraph") {
+      emulator->m_call_graph.m_enabled = true;
+    } else if (arg.find("--trace=") == 0) {
+      emulator->m_trace.m_recording = true;
+      emulator->m_trace.m_file = arg.substr(TRACE_ARG_OFF);
+    } else if (arg.find("--replay=") == 0) {
+      emulator->m_trace.m_replaying = true;
+      emulator->m_trace.m_file = arg.substr(REPLAY_ARG_OFF);
+    } else if (arg.find("--snapshot=") == 0) {
+      emulator->m_snapshot.m_file = arg.substr(SNAPSHOT_ARG_OFF);
+    } else if (arg.find("--snapshot-at=") == 0) {
+      if (!parseOptionNumber(arg.substr(SNAPSHOT_AT_ARG_OFF), emulator->m_snapshot.m_instr)) {
+        std::cerr << "Greska: Neispravna vrednost opcije: " << arg << std::endl;
+        return 1;
+      }
+    } else if (arg.find("--restore=") == 0) {
+      a_restore_file = arg.substr(RESTORE_ARG_OFF);
+    } else if (arg == "--no-idle") {
+      emulator->m_idle.m_enabled = false;
+    } else if (arg == "--headless") {
+      emulator->m_terminal.m_headless = true;
+    } else if (arg.find("--input=") == 0) {
+      emulator->m_terminal.m_headless = true;
+      emulator->m_terminal.m_input_file = arg.substr(INPUT_ARG_OFF);
+    } else if (arg.find("--output=") == 0) {
+      emulator->m_terminal.m_headless = true;
+      emulator->m_terminal.m_output_file = arg.substr(OUTPUT_ARG_OFF);
+    } else if (arg.find("--batch=") == 0) {
+      a_batch_config.m_list_file = arg.substr(BATCH_ARG_OFF);
+    } else if (arg.find("--batch-out=") == 0) {
+      a_batch_config.m_output_dir = arg.substr(BATCH_OUT_ARG_OFF);
+    } else if (arg.find("--jobs=") == 0) {
+      if (!parseOptionNumber(arg.substr(JOBS_ARG_OFF), a_batch_config.m_jobs)) {
+        std::cerr << "Greska: Neispravna vrednost opcije: " << arg << std::endl;
+        return 1;
+      }
+    } else if (arg.find("--symtab=") == 0) {
+      emulator->m_profiler.m_symtab_file = arg.substr(SYMTAB_ARG_OFF);
+    } else if (arg.find("--folded=") == 0) {
+      emulator->m_profiler.m_enabled = true;
+      emulator->m_profiler.m_folded_file = arg.substr(FOLDED_ARG_OFF);
+    } else if (arg == "-vtime") {
+      emulator->m_timer.m_virtual = true;
+      emulator->m_timer.m_instrs_per_ms = DEFAULT_INSTRS_PER_MS;
+    } else if (arg.find("-vtime=") == 0) {
+      emulator->m_timer.m_virtual = true;
+      if (!parseOptionNumber(arg.substr(VTIME_ARG_OFF), emulator->m_timer.m_instrs_per_ms)) {
+        std::cerr << "Greska: Neispravna vrednost opcije: " << arg << std::endl;
+        return 1;
+      }
+      if (emulator->m_timer.m_instrs_per_ms == 0) {
+        std::cerr << "Greska: Broj instrukcija po milisekundi mora biti pozitivan" << std::endl;
+        return 1;
+      }
+    } else if (arg.find("-term-out=") == 0) {
+      term_out_file = arg.substr(TERM_OUT_ARG_OFF);
+    } else if (a_input_file.empty()) {
+      a_input_file = arg;
+    } else {
+      std::cerr << "Greska: Nedozvoljen broj argumenata" << std::endl;
+      return 1;
+    }
+  }
+  if (emulator->m_snapshot.m_instr != SNAPSHOT_AT_HALT && emulator->m_snapshot.m_file.empty()) {
+    std::cerr << "Greska: Opcija --snapshot-at zahteva --snapshot" << std::endl;
+    return 1;
+  }
+  if (emulator->m_trace.m_recording && emulator->m_trace.m_replaying) {
+    std::cerr << "Greska: Nije moguce istovremeno snimati i reprodukovati trag" << std::endl;
+    return 1;
+  }
+  if (!a_batch_config.m_list_file.empty()) {
+    if (!a_input_file.empty() || !a_restore_file.empty() || 
+        emulator->m_stats.m_enabled || emulator->m_profiler.m_enabled || emulator->m_call_graph.m_enabled ||
+        !term_out_file.empty() || !emulator->m_terminal.m_output_file.empty()) {
+      std::cerr << "Greska: Uz opciju --batch su dozvoljene samo -vtime, --no-idle, --jobs, --batch-out, " 
+        << "--headless, --input, --snapshot, --snapshot-at, --trace i --replay" << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+  if (!a_batch_config.m_output_dir.empty()) {
+    std::cerr << "Greska: Opcija --batch-out zahteva --batch" << std::endl;
+    return 1;
+  }
+  if (a_input_file.empty() == a_restore_file.empty()) {
     std::cerr << "Greska: Nedozvoljen broj argumenata" << std::endl;
     return 1;
   }
-  a_input_file = std::string(argv[1]);
+  if (emulator->m_terminal.m_headless && !term_out_file.empty()) {
+    std::cerr << "Greska: Opcija -term-out nije dozvoljena uz --headless" << std::endl;
+    return 1;
+  }
+  if (!term_out_file.empty() && !openTerminalOutput(term_out_file)) {
+    std::cerr << "Greska prilikom otvaranja fajla: " << term_out_file << "\n";
+    return 1;
+  }
   return 0;
 }
 
+void invalidateDecoded(uint32_t a_addr, uint32_t a_len) {
+  DecodeCache& cache = emulator->m_decode_cache;
+  uint32_t first_slot = a_addr / INSTR_SIZE;
+  uint32_t last_slot = (a_addr + a_len - 1) / INSTR_SIZE;
+  for (uint32_t slot = first_slot; ; slot = (slot + 1) & INSTR_SLOT_MASK) {
+    uint32_t page_num = slot / PAGE_INSTR_NUM;
+    if (cache.m_code_pages[page_num]) {
+      DecodedPage& page = *cache.m_pages[page_num];
+      page.m_valid.reset(slot % PAGE_INSTR_NUM);
+      if (page.m_translated[slot % PAGE_INSTR_NUM]) {
+        page.m_self_modifying = true;
+        emulator->m_block_cache.m_flush_pending = true;
+      }
+    }
+    if (slot == last_slot) {
+      break;
+    }
+  }
+}
+
 void writeMem32(uint32_t a_addr, uint8_t a_byte) {
-  emulator.m_mem32[a_addr] = a_byte;
+  memWriteByte(emulator->m_mem32, a_addr, a_byte);
+  if (emulator->m_decode_cache.m_code_pages[a_addr >> PAGE_BITS]) {
+    invalidateDecoded(a_addr, 1);
+  }
 }
 
 void writeWord(uint32_t a_addr, uint32_t a_word) {
-  writeMem32(a_addr, static_cast<uint8_t>(a_word & 0xFF));
-  writeMem32(a_addr + 1, static_cast<uint8_t>((a_word >> 8) & 0xFF));
-  writeMem32(a_addr + 2, static_cast<uint8_t>((a_word >> 16) & 0xFF));
-  writeMem32(a_addr + 3, static_cast<uint8_t>((a_word >> 24) & 0xFF));
+  if (isMmioAddr(a_addr)) {
+    emulator->m_stats.m_mmio_writes++;
+    mmioWrite(a_addr, a_word);
+    return;
+  }
+  memWriteWord(emulator->m_mem32, a_addr, a_word);
+  if (emulator->m_decode_cache.m_code_pages[a_addr >> PAGE_BITS] ||
+      emulator->m_decode_cache.m_code_pages[(a_addr + 3) >> PAGE_BITS]) {
+    invalidateDecoded(a_addr, WORD_SIZE);
+  }
 }
 
 uint8_t readMem32(uint32_t a_addr) {
-  if (emulator.m_mem32.find(a_addr) != emulator.m_mem32.end()) {
-    return emulator.m_mem32[a_addr];
-  } else {
-    return 0x00;
-  }
+  return memReadByte(emulator->m_mem32, a_addr);
 }
 
 uint32_t readWord(uint32_t a_addr) {
-  return static_cast<uint32_t>(readMem32(a_addr)) | 
-    (static_cast<uint32_t>(readMem32(a_addr + 1)) << 8) |
-    (static_cast<uint32_t>(readMem32(a_addr + 2)) << 16) |
-    (static_cast<uint32_t>(readMem32(a_addr + 3)) << 24);
+  if (isMmioAddr(a_addr)) {
+    emulator->m_stats.m_mmio_reads++;
+    return mmioRead(a_addr);
+  }
+  return memReadWord(emulator->m_mem32, a_addr);
 }
 
 uint32_t readInstr(uint32_t a_addr) {
-  return (static_cast<uint32_t>(readMem32(a_addr)) << 24) | 
-    (static_cast<uint32_t>(readMem32(a_addr + 1)) << 16) |
-    (static_cast<uint32_t>(readMem32(a_addr + 2)) << 8) |
-    static_cast<uint32_t>(readMem32(a_addr + 3));
+  return memReadInstr(emulator->m_mem32, a_addr);
 }
 
 void showMem32() {
   std::cout << std::uppercase << std::right << std::hex << std::setfill('0');
-  for (const auto& [addr, byte] : emulator.m_mem32) {
-    if (addr % 8 == 0) {
-      std::cout << std::setw(8)  << addr << ": ";
+  for (uint32_t dir = 0; dir < PAGE_DIR_SIZE; dir++) {
+    if (emulator->m_mem32.m_page_dir[dir] == nullptr) {
+      continue;
     }
+    for (uint32_t table = 0; table < PAGE_TABLE_SIZE; table++) {
+      const auto& page = (*emulator->m_mem32.m_page_dir[dir])[table];
+      if (page == nullptr) {
+        continue;
+      }
+      uint32_t page_addr = (dir << (PAGE_BITS + PAGE_TABLE_BITS)) | (table << PAGE_BITS);
+      for (uint32_t off = 0; off < PAGE_SIZE; off++) {
+        uint32_t addr = page_addr + off;
+        if (addr % 8 == 0) {
+          std::cout << std::setw(8)  << addr << ": ";
+        }
 
-    std::cout << std::setw(2) << static_cast<uint16_t>(byte & 0x00FF);
+        std::cout << std::setw(2) << static_cast<uint16_t>((*page)[off] & 0x00FF);
 
-    if (addr % 8 == 7) {
-      std::cout << "\n";
-    } else if (addr % 8 == 3) {
-      std::cout << "   ";
-    } else {
-      std::cout << " ";
+        if (addr % 8 == 7) {
+          std::cout << "\n";
+        } else if (addr % 8 == 3) {
+          std::cout << "   ";
+        } else {
+          std::cout << " ";
+        }
+      }
     }
   }
 
@@ -100,7 +294,7 @@ void showEmulatorState() {
     for (size_t j = 0; j < 4; j++) {
       std::string gpr_out = "r" + std::to_string(i*4+j) + "=0x";
       std::cout << std::uppercase << std::right << std::setw(6) << std::setfill(' ') << gpr_out;
-      std::cout << std::setw(8) << std::hex << std::setfill('0') << emulator.m_gpr[i*4+j]
+      std::cout << std::setw(8) << std::hex << std::setfill('0') << emulator->m_gpr[i*4+j]
         << std::dec << std::setfill(' ');
       std::cout << "   ";
     }
@@ -108,386 +302,1486 @@ void showEmulatorState() {
   }
 }
 
-int32_t parseHexFile(std::string& a_input_file) {
-  std::ifstream in(a_input_file);
+Instruction decodeInstr(uint32_t a_word) {
+  uint8_t oc = static_cast<uint8_t>((a_word & 0xF0000000) >> 28);
+  uint8_t mod = static_cast<uint8_t>((a_word & 0x0F000000) >> 24);
+  uint8_t reg_a = static_cast<uint8_t>((a_word & 0x00F00000) >> 20);
+  uint8_t reg_b = static_cast<uint8_t>((a_word & 0x000F0000) >> 16);
+  uint8_t reg_c = static_cast<uint8_t>((a_word & 0x0000F000) >> 12);
+  int16_t disp = static_cast<int16_t>(static_cast<int32_t>(a_word << 20) >> 20);
 
-  if (!in.is_open()) {
-      std::cerr << "Greska prilikom otvaranja fajla: " << a_input_file << "\n";
-      return 1;
-  }
+  return Instruction(oc, mod, reg_a, reg_b, reg_c, disp);
+}
 
-  std::string line;
-  while(getline(in, line)) {
-    std::istringstream iss(line);
-    std::string addr_representation;
-    std::string byte_representation;
-    iss >> addr_representation;
-    uint32_t addr_val = static_cast<uint32_t>(
-      std::stoul(addr_representation.substr(0, addr_representation.size() - 1), nullptr, 16)
-    );
-    while (iss >> byte_representation) {
-        uint8_t byte_val = static_cast<uint8_t>(std::stoul(byte_representation, nullptr, 16));
-        writeMem32(addr_val, byte_val);
-        addr_val++;
-    }
+DecodedPage* decodedPage(uint32_t a_page_num) {
+  DecodeCache& cache = emulator->m_decode_cache;
+  if (cache.m_last_page != nullptr && cache.m_last_page_num == a_page_num) {
+    return cache.m_last_page;
   }
-
-  in.close();
-  return 0;
+  std::unique_ptr<DecodedPage>& page = cache.m_pages[a_page_num];
+  if (page == nullptr) {
+    page = std::make_unique<DecodedPage>();
+    cache.m_code_pages[a_page_num] = true;
+  }
+  cache.m_last_page_num = a_page_num;
+  cache.m_last_page = page.get();
+  return page.get();
 }
 
+/// Word aligned instructions are decoded once and served from the decode
+/// cache until a store hits their slot, unaligned ones are decoded every time.
 Instruction loadInstr(uint32_t& a_pc) {
-  uint32_t word = readInstr(a_pc);
+  uint32_t pc = a_pc;
   a_pc+= WORD_SIZE;
-  
-  uint8_t oc = static_cast<uint8_t>((word & 0xF0000000) >> 28);
-  uint8_t mod = static_cast<uint8_t>((word & 0x0F000000) >> 24);
-  uint8_t reg_a = static_cast<uint8_t>((word & 0x00F00000) >> 20);
-  uint8_t reg_b = static_cast<uint8_t>((word & 0x000F0000) >> 16);
-  uint8_t reg_c = static_cast<uint8_t>((word & 0x0000F000) >> 12);
-  int16_t disp = static_cast<int16_t>(static_cast<int32_t>(word << 20) >> 20);
 
-  return Instruction(oc, mod, reg_a, reg_b, reg_c, disp);
+  if (pc % INSTR_SIZE != 0) {
+    return decodeInstr(readInstr(pc));
+  }
+
+  DecodedPage* page = decodedPage(pc >> PAGE_BITS);
+  uint32_t slot = (pc & PAGE_OFFSET_MASK) / INSTR_SIZE;
+  if (!page->m_valid[slot]) {
+    page->m_instrs[slot] = decodeInstr(readInstr(pc));
+    page->m_valid.set(slot);
+  }
+  return page->m_instrs[slot];
 }
 
 void push(uint32_t a_val) {
-  emulator.m_gpr[SP]-= 4;
-  writeWord(emulator.m_gpr[SP], a_val);
+  emulator->m_gpr[SP]-= 4;
+  writeWord(emulator->m_gpr[SP], a_val);
 }
 
 void pop(uint32_t& a_dst) {
-  a_dst = readWord(emulator.m_gpr[SP]);
-  emulator.m_gpr[SP]+= 4;
+  a_dst = readWord(emulator->m_gpr[SP]);
+  emulator->m_gpr[SP]+= 4;
 }
 
 void printInstruction(uint8_t a_oc) {
   switch (a_oc) {
     case OpCode::HALT:
-      std::cout << "HALT instruction on " << std::hex << emulator.m_gpr[PC] << std::dec << std::endl;
+      std::cout << "HALT instruction on " << std::hex << emulator->m_gpr[PC] << std::dec << std::endl;
       break;
     case OpCode::INT:
-      std::cout << "INT instruction on " << std::hex << emulator.m_gpr[PC] << std::dec << std::endl;
+      std::cout << "INT instruction on " << std::hex << emulator->m_gpr[PC] << std::dec << std::endl;
       break;
     case OpCode::CALL:
-      std::cout << "CALL instruction on " << std::hex << emulator.m_gpr[PC] << std::dec << std::endl;
+      std::cout << "CALL instruction on " << std::hex << emulator->m_gpr[PC] << std::dec << std::endl;
       break;
     case OpCode::JMP:
-      std::cout << "JMP instruction on " << std::hex << emulator.m_gpr[PC] << std::dec << std::endl;
+      std::cout << "JMP instruction on " << std::hex << emulator->m_gpr[PC] << std::dec << std::endl;
       break;
     case OpCode::XCHG:
-      std::cout << "XCHG instruction on " << std::hex << emulator.m_gpr[PC] << std::dec << std::endl;
+      std::cout << "XCHG instruction on " << std::hex << emulator->m_gpr[PC] << std::dec << std::endl;
       break;
     case OpCode::ARITHMETIC:
-      std::cout << "ARITHMETIC instruction on " << std::hex << emulator.m_gpr[PC] << std::dec << std::endl;
+      std::cout << "ARITHMETIC instruction on " << std::hex << emulator->m_gpr[PC] << std::dec << std::endl;
       break;
     case OpCode::LOGIC:
-      std::cout << "LOGIC instruction on " << std::hex << emulator.m_gpr[PC] << std::dec << std::endl;
+      std::cout << "LOGIC instruction on " << std::hex << emulator->m_gpr[PC] << std::dec << std::endl;
       break;
     case OpCode::SHIFT:
-      std::cout << "SHIFT instruction on " << std::hex << emulator.m_gpr[PC] << std::dec << std::endl;
+      std::cout << "SHIFT instruction on " << std::hex << emulator->m_gpr[PC] << std::dec << std::endl;
       break;
     case OpCode::ST:
-      std::cout << "ST instruction on " << std::hex << emulator.m_gpr[PC] << std::dec << std::endl;
+      std::cout << "ST instruction on " << std::hex << emulator->m_gpr[PC] << std::dec << std::endl;
       break;
     case OpCode::LD:
-      std::cout << "LD instruction on " << std::hex << emulator.m_gpr[PC] << std::dec << std::endl;
+      std::cout << "LD instruction on " << std::hex << emulator->m_gpr[PC] << std::dec << std::endl;
       break;
     default:
-      std::cout << "Unknown instruction on " << std::hex << emulator.m_gpr[PC] << std::dec << std::endl;
+      std::cout << "Unknown instruction on " << std::hex << emulator->m_gpr[PC] << std::dec << std::endl;
       break;
   }
 }
 
-void execute() {
-  emulator.m_gpr[PC] = 0x40000000;
+
+/// True when a scripted key has reached its instruction count but has not
+/// been typed, it waits for a handler or an unmasked terminal.
+inline bool scriptKeyDue() {
+  const TerminalState& terminal = emulator->m_terminal;
+  return terminal.m_headless && terminal.m_input_pos < terminal.m_input.size() &&
+    terminal.m_input[terminal.m_input_pos].m_instr_cnt <= emulator->m_instr_cnt;
+}
+
+/// Unmasking in status lets a pending interrupt in before the next
+/// instruction, the poll deadline is pulled in to make that happen. The
+/// same goes for a due scripted key once status or handler change.
+inline void writeCsr(uint8_t a_csr, uint32_t a_val) {
+  emulator->m_csr[a_csr] = a_val;
+  if ((a_csr == Csr::STATUS && emulator->m_irq.m_pending != 0) ||
+      ((a_csr == Csr::STATUS || a_csr == Csr::HANDLER) && scriptKeyDue())) {
+    emulator->m_next_poll_instr = emulator->m_instr_cnt;
+  }
+}
+
+void execInt(const Instruction&) {
+  // push status; push pc; cause<=4; status<=status&(~0x1); pc<=handle;
+  push(emulator->m_csr[Csr::STATUS]);
+  push(emulator->m_gpr[PC]);
+  emulator->m_csr[Csr::CAUSE] = CAUSE_SOFTWARE;
+  writeCsr(Csr::STATUS, emulator->m_csr[Csr::STATUS] & ~0x00000001);
+  emulator->m_gpr[PC] = emulator->m_csr[Csr::HANDLER];
+}
+
+void execCallPcRel(const Instruction& a_instr) {
+  // push pc; pc<=gpr[A]+gpr[B]+D;
+  push(emulator->m_gpr[PC]);
+  emulator->m_gpr[PC] = 
+    emulator->m_gpr[a_instr.m_reg_a] + emulator->m_gpr[a_instr.m_reg_b] + a_instr.m_disp;
+}
+
+void execCallMemRel(const Instruction& a_instr) {
+  // push pc; pc<=mem32[gpr[A]+gpr[B]+D];
+  push(emulator->m_gpr[PC]);
+  emulator->m_gpr[PC] = 
+    readWord(emulator->m_gpr[a_instr.m_reg_a] + emulator->m_gpr[a_instr.m_reg_b] + a_instr.m_disp);
+}
+
+void execJmpPcRel(const Instruction& a_instr) {
+  // pc<=gpr[A]+D;
+  emulator->m_gpr[PC] = emulator->m_gpr[a_instr.m_reg_a] + a_instr.m_disp;
+}
+
+void execBeqPcRel(const Instruction& a_instr) {
+  // if (gpr[B] == gpr[C]) pc<=gpr[A]+D;
+  if (emulator->m_gpr[a_instr.m_reg_b] == emulator->m_gpr[a_instr.m_reg_c]) {
+    emulator->m_gpr[PC] = emulator->m_gpr[a_instr.m_reg_a] + a_instr.m_disp;
+  }
+}
+
+void execBnePcRel(const Instruction& a_instr) {
+  // if (gpr[B] != gpr[C]) pc<=gpr[A]+D;
+  if (emulator->m_gpr[a_instr.m_reg_b] != emulator->m_gpr[a_instr.m_reg_c]) {
+    emulator->m_gpr[PC] = emulator->m_gpr[a_instr.m_reg_a] + a_instr.m_disp;
+  }
+}
+
+void execBgtPcRel(const Instruction& a_instr) {
+  // if (gpr[B] signed> gpr[C]) pc<=gpr[A]+D;
+  if (static_cast<int32_t>(emulator->m_gpr[a_instr.m_reg_b]) != 
+      static_cast<int32_t>(emulator->m_gpr[a_instr.m_reg_c])) {
+    emulator->m_gpr[PC] = emulator->m_gpr[a_instr.m_reg_a] + a_instr.m_disp;
+  }
+}
+
+void execJmpMemRel(const Instruction& a_instr) {
+  // pc<=mem32[gpr[A]+D];
+  emulator->m_gpr[PC] = readWord(emulator->m_gpr[a_instr.m_reg_a] + a_instr.m_disp);
+}
+
+void execBeqMemRel(const Instruction& a_instr) {
+  // if (gpr[B] == gpr[C]) pc<=mem32[gpr[A]+D];
+  if (emulator->m_gpr[a_instr.m_reg_b] == emulator->m_gpr[a_instr.m_reg_c]) {
+    emulator->m_gpr[PC] = readWord(emulator->m_gpr[a_instr.m_reg_a] + a_instr.m_disp);
+  }
+}
+
+void execBneMemRel(const Instruction& a_instr) {
+  // if (gpr[B] != gpr[C]) pc<=mem32[gpr[A]+D];
+  if (emulator->m_gpr[a_instr.m_reg_b] != emulator->m_gpr[a_instr.m_reg_c]) {
+    emulator->m_gpr[PC] = readWord(emulator->m_gpr[a_instr.m_reg_a] + a_instr.m_disp);
+  }
+}
+
+void execBgtMemRel(const Instruction& a_instr) {
+  // if (gpr[B] signed> gpr[C]) pc<=mem32[gpr[A]+D];
+  if (static_cast<int32_t>(emulator->m_gpr[a_instr.m_reg_b]) != 
+      static_cast<int32_t>(emulator->m_gpr[a_instr.m_reg_c])) {
+    emulator->m_gpr[PC] = readWord(emulator->m_gpr[a_instr.m_reg_a] + a_instr.m_disp);
+  }
+}
+
+void execXchg(const Instruction& a_instr) {
+  // temp<=gpr[B]; gpr[B]<=gpr[C]; gpr[C]<=temp;
+  std::swap(emulator->m_gpr[a_instr.m_reg_b], emulator->m_gpr[a_instr.m_reg_c]);
+}
+
+void execAdd(const Instruction& a_instr) {
+  // gpr[A]<=gpr[B] + gpr[C];
+  emulator->m_gpr[a_instr.m_reg_a] = 
+    emulator->m_gpr[a_instr.m_reg_b] + emulator->m_gpr[a_instr.m_reg_c];
+}
+
+void execSub(const Instruction& a_instr) {
+  // gpr[A]<=gpr[B] - gpr[C];
+  emulator->m_gpr[a_instr.m_reg_a] = 
+    emulator->m_gpr[a_instr.m_reg_b] - emulator->m_gpr[a_instr.m_reg_c];
+}
+
+void execMul(const Instruction& a_instr) {
+  // gpr[A]<=gpr[B] * gpr[C];
+  emulator->m_gpr[a_instr.m_reg_a] = 
+    emulator->m_gpr[a_instr.m_reg_b] * emulator->m_gpr[a_instr.m_reg_c];
+}
+
+void execDiv(const Instruction& a_instr) {
+  // gpr[A]<=gpr[B] / gpr[C];
+  emulator->m_gpr[a_instr.m_reg_a] = 
+    emulator->m_gpr[a_instr.m_reg_b] / emulator->m_gpr[a_instr.m_reg_c];
+}
+
+void execNot(const Instruction& a_instr) {
+  // gpr[A]<=~gpr[B];
+  emulator->m_gpr[a_instr.m_reg_a] = ~emulator->m_gpr[a_instr.m_reg_b];
+}
+
+void execAnd(const Instruction& a_instr) {
+  // gpr[A]<=gpr[B] & gpr[C];
+  emulator->m_gpr[a_instr.m_reg_a] = 
+    emulator->m_gpr[a_instr.m_reg_b] & emulator->m_gpr[a_instr.m_reg_c];
+}
+
+void execOr(const Instruction& a_instr) {
+  // gpr[A]<=gpr[B] | gpr[C];
+  emulator->m_gpr[a_instr.m_reg_a] = 
+    emulator->m_gpr[a_instr.m_reg_b] | emulator->m_gpr[a_instr.m_reg_c];
+}
+
+void execXor(const Instruction& a_instr) {
+  // gpr[A]<=gpr[B] ^ gpr[C];
+  emulator->m_gpr[a_instr.m_reg_a] = 
+    emulator->m_gpr[a_instr.m_reg_b] ^ emulator->m_gpr[a_instr.m_reg_c];
+}
+
+void execShl(const Instruction& a_instr) {
+  // gpr[A]<=gpr[B] << gpr[C];
+  emulator->m_gpr[a_instr.m_reg_a] = 
+    emulator->m_gpr[a_instr.m_reg_b] << emulator->m_gpr[a_instr.m_reg_c];
+}
+
+void execShr(const Instruction& a_instr) {
+  // gpr[A]<=gpr[B] >> gpr[C];
+  emulator->m_gpr[a_instr.m_reg_a] = 
+    emulator->m_gpr[a_instr.m_reg_b] >> emulator->m_gpr[a_instr.m_reg_c];
+}
+
+void execStMemRel(const Instruction& a_instr) {
+  // mem32[gpr[A]+gpr[B]+D]<=gpr[C];
+  writeWord(
+    emulator->m_gpr[a_instr.m_reg_a] + emulator->m_gpr[a_instr.m_reg_b] + a_instr.m_disp,
+    emulator->m_gpr[a_instr.m_reg_c]
+  );
+}
+
+void execStMemIndDisp(const Instruction& a_instr) {
+  // gpr[A]<=gpr[A]+D; mem32[gpr[A]]<=gpr[C];
+  emulator->m_gpr[a_instr.m_reg_a]+= a_instr.m_disp; 
+  writeWord(emulator->m_gpr[a_instr.m_reg_a], emulator->m_gpr[a_instr.m_reg_c]);
+}
+
+void execStMemInd(const Instruction& a_instr) {
+  // mem32[mem32[gpr[A]+gpr[B]+D]]<=gpr[C];
+  writeWord(
+    readWord(emulator->m_gpr[a_instr.m_reg_a] + emulator->m_gpr[a_instr.m_reg_b] + a_instr.m_disp),
+    emulator->m_gpr[a_instr.m_reg_c]
+  );
+}
+
+void execLdGprDir(const Instruction& a_instr) {
+  // gpr[A]<=csr[B];
+  emulator->m_gpr[a_instr.m_reg_a] = emulator->m_csr[a_instr.m_reg_b];
+}
+
+void execLdGprPcRel(const Instruction& a_instr) {
+  // gpr[A]<=gpr[B]+D;
+  emulator->m_gpr[a_instr.m_reg_a] = emulator->m_gpr[a_instr.m_reg_b] + a_instr.m_disp;
+}
+
+void execLdGprMemInd(const Instruction& a_instr) {
+  // gpr[A]<=mem32[gpr[B]+gpr[C]+D];
+  emulator->m_gpr[a_instr.m_reg_a] = readWord(
+    emulator->m_gpr[a_instr.m_reg_b] + emulator->m_gpr[a_instr.m_reg_c] + a_instr.m_disp
+  );
+}
+
+void execLdGprMemIndDisp(const Instruction& a_instr) {
+  // gpr[A]<=mem32[gpr[B]]; gpr[B]<=gpr[B]+D;
+  emulator->m_gpr[a_instr.m_reg_a] = readWord(emulator->m_gpr[a_instr.m_reg_b]);
+  emulator->m_gpr[a_instr.m_reg_b] = emulator->m_gpr[a_instr.m_reg_b] + a_instr.m_disp;
+}
+
+void execLdCsrDir(const Instruction& a_instr) {
+  // csr[A]<=gpr[B]
+  writeCsr(a_instr.m_reg_a, emulator->m_gpr[a_instr.m_reg_b]);
+}
+
+void execLdCsrPcRel(const Instruction& a_instr) {
+  // csr[A]<=csr[B]|D;
+  writeCsr(a_instr.m_reg_a, emulator->m_gpr[a_instr.m_reg_b] | a_instr.m_disp);
+}
+
+void execLdCsrMemInd(const Instruction& a_instr) {
+  // csr[A]<=mem32[gpr[B]+gpr[C]+D];
+  writeCsr(a_instr.m_reg_a, readWord(
+    emulator->m_gpr[a_instr.m_reg_b] + emulator->m_gpr[a_instr.m_reg_c] + a_instr.m_disp
+  ));
+}
+
+void execLdCsrMemIndDisp(const Instruction& a_instr) {
+  // csr[A]<=mem32[gpr[B]]; gpr[B]<=gpr[B]+D;
+  writeCsr(a_instr.m_reg_a, readWord(emulator->m_gpr[a_instr.m_reg_b]));
+  emulator->m_gpr[a_instr.m_reg_b] = emulator->m_gpr[a_instr.m_reg_b] + a_instr.m_disp;
+}
+
+/// Devices are polled once every POLL_INTERVAL instructions, so the hot
+/// loop only compares the instruction counter against the next deadline.
+const uint64_t POLL_INTERVAL = 1024;
+
+uint32_t readTermIn(uint32_t) {
+  return emulator->m_terminal.m_in;
+}
+
+void writeTermOut(uint32_t, uint32_t a_val) {
+  if (emulator->m_terminal.m_headless) {
+    emulator->m_terminal.m_output.push_back(static_cast<char>(a_val & 0xFF));
+    return;
+  }
+  writeTerminalChar(static_cast<char>(a_val & 0xFF));
+}
+
+uint32_t readTimCfg(uint32_t) {
+  for (const auto& [cfg, period_ms] : timer_config_map) {
+    if (static_cast<int32_t>(period_ms) == emulator->m_timer.m_config_ms) {
+      return cfg;
+    }
+  }
+  return 0x00000000;
+}
+
+void writeTimCfg(uint32_t, uint32_t a_val) {
+  if (timer_config_map.find(a_val) != timer_config_map.end()) {
+    emulator->m_timer.m_config_ms = timer_config_map[a_val];
+  } else {
+    std::cerr << "Greska: Nevalidna vrednost za konfiguraciju tajmera" << std::endl;
+  }
+}
+
+/// Drops decoded instructions of the code pages in a range, other pages are
+/// skipped without looking at their slots.
+void invalidateRange(uint32_t a_addr, uint32_t a_len) {
+  while (a_len > 0) {
+    uint32_t chunk = std::min(a_len, PAGE_SIZE - (a_addr & PAGE_OFFSET_MASK));
+    if (emulator->m_decode_cache.m_code_pages[a_addr >> PAGE_BITS]) {
+      invalidateDecoded(a_addr, chunk);
+    }
+    a_addr+= chunk;
+    a_len-= chunk;
+  }
+}
+
+/// A range is transferable when it neither wraps nor reaches into MMIO.
+bool dmaRangeValid(uint32_t a_addr, uint32_t a_len) {
+  return a_len == 0 || (a_addr <= MMIO_BASE && a_len <= MMIO_BASE - a_addr);
+}
+
+bool runDma(uint32_t a_op) {
+  DmaState& dma = emulator->m_dma;
+  if (!dmaRangeValid(dma.m_dst, dma.m_len)) {
+    return false;
+  }
+  if (a_op == DMA_OP_COPY) {
+    if (!dmaRangeValid(dma.m_src, dma.m_len)) {
+      return false;
+    }
+    memCopy(emulator->m_mem32, dma.m_dst, dma.m_src, dma.m_len);
+  } else if (a_op == DMA_OP_FILL) {
+    memFill(emulator->m_mem32, dma.m_dst, static_cast<uint8_t>(dma.m_src & 0xFF), dma.m_len);
+  } else {
+    return false;
+  }
+  invalidateRange(dma.m_dst, dma.m_len);
+  return true;
+}
+
+uint32_t readDma(uint32_t a_addr) {
+  const DmaState& dma = emulator->m_dma;
+  switch (a_addr) {
+    case dma_src: return dma.m_src;
+    case dma_dst: return dma.m_dst;
+    case dma_len: return dma.m_len;
+    default: return dma.m_status;
+  }
+}
+
+void writeDma(uint32_t a_addr, uint32_t a_val) {
+  DmaState& dma = emulator->m_dma;
+  switch (a_addr) {
+    case dma_src: dma.m_src = a_val; return;
+    case dma_dst: dma.m_dst = a_val; return;
+    case dma_len: dma.m_len = a_val; return;
+  }
+  dma.m_status = runDma(a_val & DMA_OP_MASK) ? DMA_STATUS_DONE : DMA_STATUS_ERROR;
+  if ((a_val & DMA_CTRL_IRQ) != 0) {
+    requestIrq(emulator->m_irq, CAUSE_DMA);
+    emulator->m_next_poll_instr = emulator->m_instr_cnt;
+  }
+}
+
+void initDevices() {
+  registerMmioDevice(term_out, WORD_SIZE, nullptr, writeTermOut);
+  registerMmioDevice(term_in, WORD_SIZE, readTermIn, nullptr);
+  registerMmioDevice(tim_cfg, WORD_SIZE, readTimCfg, writeTimCfg);
+  registerMmioDevice(dma_src, dma_ctrl + WORD_SIZE - dma_src, readDma, writeDma);
+}
+
+void startTimer() {
+  emulator->m_timer.m_start_instr = emulator->m_instr_cnt;
+  emulator->m_timer.m_start_time = std::chrono::steady_clock::now();
+}
+
+void startProgram(uint32_t a_start_pc) {
+  emulator->m_gpr[PC] = a_start_pc;
+  startTimer();
+}
+
+/// First retired instruction count at which a virtual time timer expires.
+uint64_t timerDeadlineInstr() {
+  return emulator->m_timer.m_start_instr + 
+    static_cast<uint64_t>(emulator->m_timer.m_config_ms) * emulator->m_timer.m_instrs_per_ms;
+}
+
+bool timerExpired() {
+  if (emulator->m_timer.m_virtual) {
+    return emulator->m_instr_cnt >= timerDeadlineInstr();
+  }
+  auto elapsed_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - emulator->m_timer.m_start_time
+  ).count();
+  return elapsed_time >= emulator->m_timer.m_config_ms;
+}
+
+/// Runs after a hardware interrupt pushed status and pc. A call whose target
+/// has not executed yet is entered first, at the pc the interrupt saved.
+void traceCallInterrupt() {
+  CallGraph& graph = emulator->m_call_graph;
+  if (!graph.m_enabled) {
+    return;
+  }
+  if (graph.m_entry_pending) {
+    callGraphEnter(graph, readWord(emulator->m_gpr[SP]), emulator->m_instr_cnt);
+  }
+  callGraphCall(graph, emulator->m_gpr[SP]);
+}
+
+/// Register file in the order the trace uses.
+TraceRegs traceRegs() {
+  TraceRegs regs;
+  std::copy(emulator->m_gpr, emulator->m_gpr + GPR_NUM, regs.begin());
+  std::copy(emulator->m_csr, emulator->m_csr + CSR_NUM, regs.begin() + GPR_NUM);
+  return regs;
+}
+
+/// Writes or checks the record of the last captured instruction.
+void finishTraceInstr() {
+  TraceState& trace = emulator->m_trace;
+  if (!trace.m_pending) {
+    return;
+  }
+  trace.m_pending = false;
+  if (trace.m_recording) {
+    traceInstr(trace, traceRegs());
+  } else {
+    replayInstr(trace, traceRegs(), emulator->m_instr_cnt);
+  }
+}
+
+void raiseInterrupt(uint32_t a_cause) {
+  if (emulator->m_trace.m_recording || emulator->m_trace.m_replaying) {
+    finishTraceInstr();
+  }
+  if (emulator->m_trace.m_recording) {
+    traceInterrupt(
+      emulator->m_trace, 
+      TraceEvent{static_cast<uint8_t>(a_cause), emulator->m_terminal.m_in, emulator->m_instr_cnt}
+    );
+  }
+  push(emulator->m_csr[Csr::STATUS]);
+  push(emulator->m_gpr[PC]);
+  emulator->m_csr[Csr::CAUSE] = a_cause;
+  emulator->m_stats.m_interrupts[a_cause]++;
+  traceCallInterrupt();
+  emulator->m_csr[Csr::STATUS] = emulator->m_csr[Csr::STATUS] | INTERRUPT_MASK;
+  emulator->m_gpr[PC] = emulator->m_csr[Csr::HANDLER];
+}
+
+/// Interrupt lines the status register lets through.
+uint32_t enabledIrqs() {
+  uint32_t status = emulator->m_csr[Csr::STATUS];
+  if ((status & INTERRUPT_MASK) != 0) {
+    return 0;
+  }
+  uint32_t enabled = irqBit(CAUSE_DMA);
+  if ((status & TERMINAL_MASK) == 0) {
+    enabled|= irqBit(CAUSE_TERMINAL);
+  }
+  if ((status & TIMER_MASK) == 0) {
+    enabled|= irqBit(CAUSE_TIMER);
+  }
+  return enabled;
+}
+
+/// A scripted key is typed once its instruction count is reached and the
+/// guest has installed a handler. Later keys wait for it.
+bool readHeadlessChar(char& a_c) {
+  TerminalState& terminal = emulator->m_terminal;
+  if (emulator->m_csr[Csr::HANDLER] == 0 || 
+      terminal.m_input_pos >= terminal.m_input.size() || 
+      terminal.m_input[terminal.m_input_pos].m_instr_cnt > emulator->m_instr_cnt) {
+    return false;
+  }
+  a_c = terminal.m_input[terminal.m_input_pos++].m_key;
+  return true;
+}
+
+void deliverInterrupts() {
+  uint32_t ready = emulator->m_irq.m_pending & enabledIrqs();
+  if (ready != 0) {
+    raiseInterrupt(takeIrq(emulator->m_irq, ready));
+  }
+}
+
+/// term_in holds one character until its handler has run, the next one is
+/// taken from the input queue only when the terminal interrupt can be
+/// delivered again. Characters typed meanwhile wait in the queue.
+void pollDevices() {
+  InterruptController& irq = emulator->m_irq;
+  TerminalState& terminal = emulator->m_terminal;
+  if (!terminal.m_headless) {
+    flushTerminalOutputIfDue();
+  }
+  char c;
+  if (!irqPending(irq, CAUSE_TERMINAL) && (enabledIrqs() & irqBit(CAUSE_TERMINAL)) != 0 && 
+      (terminal.m_headless ? readHeadlessChar(c) : readTerminalChar(c))) {
+    terminal.m_in = static_cast<uint8_t>(c);
+    requestIrq(irq, CAUSE_TERMINAL);
+  }
+  if (emulator->m_timer.m_config_ms != -1 && timerExpired()) {
+    requestIrq(irq, CAUSE_TIMER);
+    startTimer();
+  }
+  deliverInterrupts();
+}
+
+/// In replay the devices stay quiet, interrupts come from the trace at the
+/// instruction count they were recorded at.
+void replayDevices() {
+  flushTerminalOutputIfDue();
+  TraceState& trace = emulator->m_trace;
+  while (trace.m_next_event < trace.m_events.size() && 
+         trace.m_events[trace.m_next_event].m_instr_cnt <= emulator->m_instr_cnt) {
+    const TraceEvent& event = trace.m_events[trace.m_next_event++];
+    emulator->m_terminal.m_in = event.m_term_in;
+    raiseInterrupt(event.m_cause);
+  }
+  if (trace.m_next_event < trace.m_events.size()) {
+    emulator->m_next_poll_instr = std::min(emulator->m_next_poll_instr, trace.m_events[trace.m_next_event].m_instr_cnt);
+  }
+}
+
+void takeSnapshot() {
+  SnapshotState& snapshot = emulator->m_snapshot;
+  if (!saveSnapshot(*emulator, snapshot.m_file)) {
+    std::cerr << "Greska prilikom pisanja fajla: " << snapshot.m_file << "\n";
+    snapshot.m_failed = true;
+  }
+  snapshot.m_instr = SNAPSHOT_AT_HALT;
+  snapshot.m_file.clear();
+}
+
+/// Idle loops longer than this are not recognised.
+const uint32_t MAX_IDLE_LOOP_INSTRS = 16;
+/// Longest host sleep while waiting for terminal input with no timer.
+const auto IDLE_WAIT_MAX = std::chrono::milliseconds(100);
+const uint64_t NO_EVENT = UINT64_MAX;
+
+/// Handler of an instruction that changes nothing but gpr registers and pc,
+/// nullptr for any other.
+InstrHandler pureHandler(const Instruction& a_instr) {
+  switch (a_instr.m_oc) {
+    case OpCode::JMP:
+      switch (a_instr.m_mod) {
+        case JmpMod::JMP_PC_REL: return execJmpPcRel;
+        case JmpMod::BEQ_PC_REL: return execBeqPcRel;
+        case JmpMod::BNE_PC_REL: return execBnePcRel;
+        case JmpMod::BGT_PC_REL: return execBgtPcRel;
+        case JmpMod::JMP_MEM_REL: return execJmpMemRel;
+        case JmpMod::BEQ_MEM_REL: return execBeqMemRel;
+        case JmpMod::BNE_MEM_REL: return execBneMemRel;
+        case JmpMod::BGT_MEM_REL: return execBgtMemRel;
+      }
+      return nullptr;
+    case OpCode::XCHG:
+      return execXchg;
+    case OpCode::ARITHMETIC:
+      switch (a_instr.m_mod) {
+        case ArithmeticMod::ADD: return execAdd;
+        case ArithmeticMod::SUB: return execSub;
+        case ArithmeticMod::MUL: return execMul;
+        case ArithmeticMod::DIV: return execDiv;
+      }
+      return nullptr;
+    case OpCode::LOGIC:
+      switch (a_instr.m_mod) {
+        case LogicMod::NOT: return execNot;
+        case LogicMod::AND: return execAnd;
+        case LogicMod::OR: return execOr;
+        case LogicMod::XOR: return execXor;
+      }
+      return nullptr;
+    case OpCode::SHIFT:
+      switch (a_instr.m_mod) {
+        case ShiftMod::SHL: return execShl;
+        case ShiftMod::SHR: return execShr;
+      }
+      return nullptr;
+    case OpCode::LD:
+      switch (a_instr.m_mod) {
+        case LdMod::GPR_DIR: return execLdGprDir;
+        case LdMod::GPR_PC_REL: return execLdGprPcRel;
+        case LdMod::GPR_MEM_IND: return execLdGprMemInd;
+        case LdMod::GPR_MEM_IND_DISP: return execLdGprMemIndDisp;
+      }
+      return nullptr;
+  }
+  return nullptr;
+}
+
+/// Steps the guest through pure instructions. Coming back to the start pc
+/// with the same registers means every further lap is the same until an
+/// interrupt arrives, the lap length is returned then, 0 otherwise.
+uint32_t probeIdleLoop() {
+  uint32_t start_gpr[GPR_NUM];
+  std::copy(emulator->m_gpr, emulator->m_gpr + GPR_NUM, start_gpr);
+  for (uint32_t step = 1; step <= MAX_IDLE_LOOP_INSTRS; step++) {
+    uint32_t pc = emulator->m_gpr[PC];
+    Instruction instr = loadInstr(emulator->m_gpr[PC]);
+    InstrHandler handler = pureHandler(instr);
+    if (handler == nullptr) {
+      emulator->m_gpr[PC] = pc;
+      return 0;
+    }
+    emulator->m_instr_cnt++;
+    handler(instr);
+    if (emulator->m_gpr[PC] == start_gpr[PC]) {
+      return std::equal(start_gpr, start_gpr + GPR_NUM, emulator->m_gpr) ? step : 0;
+    }
+  }
+  return 0;
+}
+
+/// First instruction count after the current one at which a device acts.
+uint64_t nextEventInstr() {
+  uint64_t next = emulator->m_snapshot.m_instr;
+  if (emulator->m_timer.m_virtual && emulator->m_timer.m_config_ms != -1) {
+    next = std::min(next, timerDeadlineInstr());
+  }
+  const TerminalState& terminal = emulator->m_terminal;
+  if (terminal.m_headless && terminal.m_input_pos < terminal.m_input.size() &&
+      terminal.m_input[terminal.m_input_pos].m_instr_cnt > emulator->m_instr_cnt) {
+    next = std::min(next, terminal.m_input[terminal.m_input_pos].m_instr_cnt);
+  }
+  return next > emulator->m_instr_cnt ? next : NO_EVENT;
+}
+
+/// Skips whole laps of an idle loop up to the next instruction time event,
+/// which keeps the guest state exactly as if they had run. Without one the
+/// host sleeps until the timer expires or terminal input arrives.
+void skipIdle(uint32_t a_lap) {
+  uint64_t next_event = nextEventInstr();
+  if (next_event != NO_EVENT) {
+    uint64_t skipped = (next_event - emulator->m_instr_cnt) / a_lap * a_lap;
+    emulator->m_instr_cnt+= skipped;
+    emulator->m_idle.m_skipped_instrs+= skipped;
+    return;
+  }
+
+  const TimerState& timer = emulator->m_timer;
+  bool wall_timer = !timer.m_virtual && timer.m_config_ms != -1;
+  auto deadline = timer.m_start_time + std::chrono::milliseconds(timer.m_config_ms);
+  if (!emulator->m_terminal.m_headless) {
+    flushTerminalOutput();
+    waitTerminalInput(wall_timer ? deadline : std::chrono::steady_clock::now() + IDLE_WAIT_MAX);
+  } else if (wall_timer) {
+    std::this_thread::sleep_until(deadline);
+  } else {
+    return;
+  }
+  emulator->m_next_poll_instr = emulator->m_instr_cnt;
+}
+
+void handleInterrupts() {
+  if (emulator->m_instr_cnt >= emulator->m_next_poll_instr) {
+    emulator->m_next_poll_instr = emulator->m_instr_cnt + POLL_INTERVAL;
+    if (emulator->m_instr_cnt >= emulator->m_snapshot.m_instr) {
+      takeSnapshot();
+    }
+    emulator->m_next_poll_instr = std::min(emulator->m_next_poll_instr, emulator->m_snapshot.m_instr);
+    if (emulator->m_trace.m_replaying) {
+      replayDevices();
+      return;
+    }
+    pollDevices();
+    if (emulator->m_timer.m_virtual && emulator->m_timer.m_config_ms != -1) {
+      emulator->m_next_poll_instr = std::min(emulator->m_next_poll_instr, std::max(timerDeadlineInstr(), emulator->m_instr_cnt + 1));
+    }
+    // a due key that could not be typed waits for writeCsr to pull the
+    // deadline in, polling it on every instruction would stall the guest
+    const TerminalState& terminal = emulator->m_terminal;
+    if (terminal.m_headless && terminal.m_input_pos < terminal.m_input.size()) {
+      uint64_t key_instr = terminal.m_input[terminal.m_input_pos].m_instr_cnt;
+      if (key_instr > emulator->m_instr_cnt) {
+        emulator->m_next_poll_instr = std::min(emulator->m_next_poll_instr, key_instr);
+      }
+    }
+    // a probe runs real instructions, it must not step over a deadline
+    if (emulator->m_idle.m_enabled && 
+        emulator->m_next_poll_instr - emulator->m_instr_cnt > MAX_IDLE_LOOP_INSTRS) {
+      uint32_t lap = probeIdleLoop();
+      if (lap != 0) {
+        skipIdle(lap);
+      }
+    }
+  }
+}
+
+/// Mirrors the conditions of the exec*PcRel and exec*MemRel handlers.
+bool branchTaken(const Instruction& a_instr) {
+  uint32_t b = emulator->m_gpr[a_instr.m_reg_b];
+  uint32_t c = emulator->m_gpr[a_instr.m_reg_c];
+  switch (a_instr.m_mod) {
+    case JmpMod::BEQ_PC_REL:
+    case JmpMod::BEQ_MEM_REL:
+      return b == c;
+    case JmpMod::BNE_PC_REL:
+    case JmpMod::BNE_MEM_REL:
+    case JmpMod::BGT_PC_REL:
+    case JmpMod::BGT_MEM_REL:
+      return b != c;
+    default:
+      return true;
+  }
+}
+
+inline void countInstr(const Instruction& a_instr) {
+  uint32_t kind = (a_instr.m_oc << 4) | a_instr.m_mod;
+  emulator->m_stats.m_instr_hist[kind]++;
+  if (a_instr.m_oc == OpCode::JMP && branchTaken(a_instr)) {
+    emulator->m_stats.m_taken_hist[kind]++;
+  }
+}
+
+/// Reads a word for the trace without counting it as a guest access.
+uint32_t peekWord(uint32_t a_addr) {
+  return isMmioAddr(a_addr) ? mmioRead(a_addr) : memReadWord(emulator->m_mem32, a_addr);
+}
+
+void addTraceMemWrite(TraceInstr& a_instr, uint32_t a_addr, uint32_t a_val) {
+  a_instr.m_mem_writes[a_instr.m_mem_write_cnt++] = TraceMemWrite{a_addr, a_val};
+}
+
+/// Finishes the record of the previous instruction and captures the pc, the
+/// instruction word and the stores of the one about to execute.
+void traceExec(uint32_t a_pc, const Instruction& a_instr) {
+  TraceState& trace = emulator->m_trace;
+  finishTraceInstr();
+  TraceInstr& instr = trace.m_instr;
+  instr.m_pc = a_pc;
+  instr.m_word = readInstr(a_pc);
+  instr.m_mem_write_cnt = 0;
+  const uint32_t* gpr = emulator->m_gpr;
+  switch (a_instr.m_oc) {
+    case OpCode::INT:
+      addTraceMemWrite(instr, gpr[SP] - WORD_SIZE, emulator->m_csr[Csr::STATUS]);
+      addTraceMemWrite(instr, gpr[SP] - 2 * WORD_SIZE, gpr[PC]);
+      break;
+    case OpCode::CALL:
+      addTraceMemWrite(instr, gpr[SP] - WORD_SIZE, gpr[PC]);
+      break;
+    case OpCode::ST:
+      switch (a_instr.m_mod) {
+        case StMod::MEM_REL:
+          addTraceMemWrite(instr, gpr[a_instr.m_reg_a] + gpr[a_instr.m_reg_b] + a_instr.m_disp, gpr[a_instr.m_reg_c]);
+          break;
+        case StMod::MEM_IND_DISP:
+          addTraceMemWrite(
+            instr, 
+            gpr[a_instr.m_reg_a] + a_instr.m_disp, 
+            a_instr.m_reg_c == a_instr.m_reg_a ? gpr[a_instr.m_reg_a] + a_instr.m_disp : gpr[a_instr.m_reg_c]
+          );
+          break;
+        case StMod::MEM_IND:
+          addTraceMemWrite(
+            instr, 
+            peekWord(gpr[a_instr.m_reg_a] + gpr[a_instr.m_reg_b] + a_instr.m_disp), 
+            gpr[a_instr.m_reg_c]
+          );
+          break;
+      }
+      break;
+  }
+  trace.m_pending = true;
+}
+
+/// Optional per instruction work. Every dispatch loop is instantiated for
+/// each combination of hooks and execute() picks one, so a disabled hook
+/// costs nothing in the hot loop.
+const uint32_t HOOK_STATS = 0x1;
+const uint32_t HOOK_PROFILE = 0x2;
+const uint32_t HOOK_CALL_GRAPH = 0x4;
+const uint32_t HOOK_TRACE = 0x8;
+const uint32_t HOOK_ALL = HOOK_STATS | HOOK_PROFILE | HOOK_CALL_GRAPH | HOOK_TRACE;
+
+/// Calls and INT push their return address below sp, `ret` and the last
+/// instruction of `iret` load pc from [sp].
+void traceCall(uint32_t a_pc, const Instruction& a_instr) {
+  CallGraph& graph = emulator->m_call_graph;
+  if (graph.m_entry_pending || graph.m_stack.empty()) {
+    callGraphEnter(graph, a_pc, emulator->m_instr_cnt - 1);
+  }
+  switch (a_instr.m_oc) {
+    case OpCode::CALL:
+      callGraphCall(graph, emulator->m_gpr[SP] - WORD_SIZE);
+      break;
+    case OpCode::INT:
+      callGraphCall(graph, emulator->m_gpr[SP] - 2 * WORD_SIZE);
+      break;
+    case OpCode::LD:
+      if (a_instr.m_mod == LdMod::GPR_MEM_IND_DISP && a_instr.m_reg_a == PC && a_instr.m_reg_b == SP) {
+        callGraphReturn(graph, emulator->m_gpr[SP], emulator->m_instr_cnt);
+      }
+      break;
+  }
+}
+
+/// Called before the instruction at a_pc executes, after it was counted in
+/// m_instr_cnt.
+template<uint32_t HOOKS>
+inline void instrHooks(uint32_t a_pc, const Instruction& a_instr) {
+  if constexpr ((HOOKS & HOOK_STATS) != 0) {
+    countInstr(a_instr);
+  }
+  if constexpr ((HOOKS & HOOK_PROFILE) != 0) {
+    profileInstr(emulator->m_profiler, a_pc);
+  }
+  if constexpr ((HOOKS & HOOK_CALL_GRAPH) != 0) {
+    traceCall(a_pc, a_instr);
+  }
+  if constexpr ((HOOKS & HOOK_TRACE) != 0) {
+    traceExec(a_pc, a_instr);
+  }
+}
+
+#if !defined(EMU_THREADED_DISPATCH) && !defined(EMU_BLOCK_DISPATCH)
+
+const char* DISPATCH_ENGINE = "switch";
+
+template<uint32_t HOOKS>
+void runEngine() {
   Instruction curr_instr;
-  auto start_time = std::chrono::high_resolution_clock::now();
-  auto end_time = start_time;
-  int32_t timer_config = -1;
-  bool timer_triggered = false;
   do {
-    curr_instr = loadInstr(emulator.m_gpr[PC]);
+    curr_instr = loadInstr(emulator->m_gpr[PC]);
+    emulator->m_instr_cnt++;
+    instrHooks<HOOKS>(emulator->m_gpr[PC] - INSTR_SIZE, curr_instr);
     switch (curr_instr.m_oc) 
     {
       case OpCode::HALT:
         break;
       case OpCode::INT:
-        // push status; push pc; cause<=4; status<=status&(~0x1); pc<=handle;
-        push(emulator.m_csr[Csr::STATUS]);
-        push(emulator.m_gpr[PC]);
-        emulator.m_csr[Csr::CAUSE] = 0x00000004;
-        emulator.m_csr[Csr::STATUS] = emulator.m_csr[Csr::STATUS] & ~0x00000001;
-        emulator.m_gpr[PC] = emulator.m_csr[Csr::HANDLER];
+        execInt(curr_instr);
         break;
       case OpCode::CALL:
         switch(curr_instr.m_mod) {
-          case CallMod::CALL_PC_REL:
-            // push pc; pc<=gpr[A]+gpr[B]+D;
-            push(emulator.m_gpr[PC]);
-            emulator.m_gpr[PC] = 
-              emulator.m_gpr[curr_instr.m_reg_a] + emulator.m_gpr[curr_instr.m_reg_b] + curr_instr.m_disp;
-            break;
-          case CallMod::CALL_MEM_REL:
-            // push pc; pc<=mem32[gpr[A]+gpr[B]+D];
-            push(emulator.m_gpr[PC]);
-            emulator.m_gpr[PC] = 
-              readWord(emulator.m_gpr[curr_instr.m_reg_a] + emulator.m_gpr[curr_instr.m_reg_b] + curr_instr.m_disp);
-            break;
+          case CallMod::CALL_PC_REL: execCallPcRel(curr_instr); break;
+          case CallMod::CALL_MEM_REL: execCallMemRel(curr_instr); break;
         }
         break;
       case OpCode::JMP:
         switch(curr_instr.m_mod) {
-          case JmpMod::JMP_PC_REL:
-            // pc<=gpr[A]+D;
-            emulator.m_gpr[PC] = emulator.m_gpr[curr_instr.m_reg_a] + curr_instr.m_disp;
-            break;
-          case JmpMod::BEQ_PC_REL:
-            // if (gpr[B] == gpr[C]) pc<=gpr[A]+D;
-            if (emulator.m_gpr[curr_instr.m_reg_b] == emulator.m_gpr[curr_instr.m_reg_c]) {
-              emulator.m_gpr[PC] = emulator.m_gpr[curr_instr.m_reg_a] + curr_instr.m_disp;
-            }
-            break;
-          case JmpMod::BNE_PC_REL:
-            // if (gpr[B] != gpr[C]) pc<=gpr[A]+D;
-            if (emulator.m_gpr[curr_instr.m_reg_b] != emulator.m_gpr[curr_instr.m_reg_c]) {
-              emulator.m_gpr[PC] = emulator.m_gpr[curr_instr.m_reg_a] + curr_instr.m_disp;
-            }
-            break;
-          case JmpMod::BGT_PC_REL:
-            // if (gpr[B] signed> gpr[C]) pc<=gpr[A]+D;
-            if (static_cast<int32_t>(emulator.m_gpr[curr_instr.m_reg_b]) != 
-                static_cast<int32_t>(emulator.m_gpr[curr_instr.m_reg_c])) {
-              emulator.m_gpr[PC] = emulator.m_gpr[curr_instr.m_reg_a] + curr_instr.m_disp;
-            }
-            break;
-          case JmpMod::JMP_MEM_REL:
-            // pc<=mem32[gpr[A]+D];
-            emulator.m_gpr[PC] = readWord(emulator.m_gpr[curr_instr.m_reg_a] + curr_instr.m_disp);
-            break;
-          case JmpMod::BEQ_MEM_REL:
-            // if (gpr[B] == gpr[C]) pc<=mem32[gpr[A]+D];
-            if (emulator.m_gpr[curr_instr.m_reg_b] == emulator.m_gpr[curr_instr.m_reg_c]) {
-              emulator.m_gpr[PC] = readWord(emulator.m_gpr[curr_instr.m_reg_a] + curr_instr.m_disp);
-            }
-            break;
-          case JmpMod::BNE_MEM_REL:
-            // if (gpr[B] != gpr[C]) pc<=mem32[gpr[A]+D];
-            if (emulator.m_gpr[curr_instr.m_reg_b] != emulator.m_gpr[curr_instr.m_reg_c]) {
-              emulator.m_gpr[PC] = readWord(emulator.m_gpr[curr_instr.m_reg_a] + curr_instr.m_disp);
-            }
-            break;
-          case JmpMod::BGT_MEM_REL:
-            // if (gpr[B] signed> gpr[C]) pc<=mem32[gpr[A]+D];
-            if (static_cast<int32_t>(emulator.m_gpr[curr_instr.m_reg_b]) != 
-                static_cast<int32_t>(emulator.m_gpr[curr_instr.m_reg_c])) {
-              emulator.m_gpr[PC] = readWord(emulator.m_gpr[curr_instr.m_reg_a] + curr_instr.m_disp);
-            }
-            break;
+          case JmpMod::JMP_PC_REL: execJmpPcRel(curr_instr); break;
+          case JmpMod::BEQ_PC_REL: execBeqPcRel(curr_instr); break;
+          case JmpMod::BNE_PC_REL: execBnePcRel(curr_instr); break;
+          case JmpMod::BGT_PC_REL: execBgtPcRel(curr_instr); break;
+          case JmpMod::JMP_MEM_REL: execJmpMemRel(curr_instr); break;
+          case JmpMod::BEQ_MEM_REL: execBeqMemRel(curr_instr); break;
+          case JmpMod::BNE_MEM_REL: execBneMemRel(curr_instr); break;
+          case JmpMod::BGT_MEM_REL: execBgtMemRel(curr_instr); break;
         }
         break;
       case OpCode::XCHG:
-        // temp<=gpr[B]; gpr[B]<=gpr[C]; gpr[C]<=temp;
-        std::swap(emulator.m_gpr[curr_instr.m_reg_b], emulator.m_gpr[curr_instr.m_reg_c]);
+        execXchg(curr_instr);
         break;
       case OpCode::ARITHMETIC:
         switch(curr_instr.m_mod) {
-          case ArithmeticMod::ADD:
-            // gpr[A]<=gpr[B] + gpr[C];
-            emulator.m_gpr[curr_instr.m_reg_a] = 
-              emulator.m_gpr[curr_instr.m_reg_b] + emulator.m_gpr[curr_instr.m_reg_c];
-            break;
-          case ArithmeticMod::SUB:
-            // gpr[A]<=gpr[B] - gpr[C];
-            emulator.m_gpr[curr_instr.m_reg_a] = 
-              emulator.m_gpr[curr_instr.m_reg_b] - emulator.m_gpr[curr_instr.m_reg_c];
-            break;
-          case ArithmeticMod::MUL:
-            // gpr[A]<=gpr[B] * gpr[C];
-            emulator.m_gpr[curr_instr.m_reg_a] = 
-              emulator.m_gpr[curr_instr.m_reg_b] * emulator.m_gpr[curr_instr.m_reg_c];
-            break;
-          case ArithmeticMod::DIV:
-            // gpr[A]<=gpr[B] / gpr[C];
-            emulator.m_gpr[curr_instr.m_reg_a] = 
-              emulator.m_gpr[curr_instr.m_reg_b] / emulator.m_gpr[curr_instr.m_reg_c];
-            break;
+          case ArithmeticMod::ADD: execAdd(curr_instr); break;
+          case ArithmeticMod::SUB: execSub(curr_instr); break;
+          case ArithmeticMod::MUL: execMul(curr_instr); break;
+          case ArithmeticMod::DIV: execDiv(curr_instr); break;
         }
         break;
       case OpCode::LOGIC:
         switch(curr_instr.m_mod) {
-          case LogicMod::NOT:
-            // gpr[A]<=~gpr[B];
-            emulator.m_gpr[curr_instr.m_reg_a] = ~emulator.m_gpr[curr_instr.m_reg_b];
-            break;
-          case LogicMod::AND:
-            // gpr[A]<=gpr[B] & gpr[C];
-            emulator.m_gpr[curr_instr.m_reg_a] = 
-              emulator.m_gpr[curr_instr.m_reg_b] & emulator.m_gpr[curr_instr.m_reg_c];
-            break;
-          case LogicMod::OR:
-            // gpr[A]<=gpr[B] | gpr[C];
-            emulator.m_gpr[curr_instr.m_reg_a] = 
-              emulator.m_gpr[curr_instr.m_reg_b] | emulator.m_gpr[curr_instr.m_reg_c];
-            break;
-          case LogicMod::XOR:
-            // gpr[A]<=gpr[B] ^ gpr[C];
-            emulator.m_gpr[curr_instr.m_reg_a] = 
-              emulator.m_gpr[curr_instr.m_reg_b] ^ emulator.m_gpr[curr_instr.m_reg_c];
-            break;
+          case LogicMod::NOT: execNot(curr_instr); break;
+          case LogicMod::AND: execAnd(curr_instr); break;
+          case LogicMod::OR: execOr(curr_instr); break;
+          case LogicMod::XOR: execXor(curr_instr); break;
         }
         break;
       case OpCode::SHIFT:
         switch (curr_instr.m_mod) {
-          case ShiftMod::SHL:
-            // gpr[A]<=gpr[B] << gpr[C];
-            emulator.m_gpr[curr_instr.m_reg_a] = 
-                emulator.m_gpr[curr_instr.m_reg_b] << emulator.m_gpr[curr_instr.m_reg_c];
-            break;
-          case ShiftMod::SHR:
-            // gpr[A]<=gpr[B] >> gpr[C];
-            emulator.m_gpr[curr_instr.m_reg_a] = 
-                emulator.m_gpr[curr_instr.m_reg_b] >> emulator.m_gpr[curr_instr.m_reg_c];
-            break;
+          case ShiftMod::SHL: execShl(curr_instr); break;
+          case ShiftMod::SHR: execShr(curr_instr); break;
         }
         break;
       case OpCode::ST:
         switch (curr_instr.m_mod) {
-          case StMod::MEM_REL:
-            // mem32[gpr[A]+gpr[B]+D]<=gpr[C];
-            writeWord(
-              emulator.m_gpr[curr_instr.m_reg_a] + emulator.m_gpr[curr_instr.m_reg_b] + curr_instr.m_disp,
-              emulator.m_gpr[curr_instr.m_reg_c]
-            );
-            break;
-          case StMod::MEM_IND_DISP:
-            // gpr[A]<=gpr[A]+D; mem32[gpr[A]]<=gpr[C];
-            emulator.m_gpr[curr_instr.m_reg_a]+= curr_instr.m_disp; 
-            writeWord(emulator.m_gpr[curr_instr.m_reg_a], emulator.m_gpr[curr_instr.m_reg_c]);
-            break;
-          case StMod::MEM_IND:
-            // mem32[mem32[gpr[A]+gpr[B]+D]]<=gpr[C];
-            if (
-              readWord(
-                emulator.m_gpr[curr_instr.m_reg_a] + 
-                emulator.m_gpr[curr_instr.m_reg_b] + 
-                curr_instr.m_disp
-              ) == term_out
-              ) {
-              std::cout << static_cast<char>(emulator.m_gpr[curr_instr.m_reg_c] & 0xFF);
-            } else if (
-              readWord(
-                emulator.m_gpr[curr_instr.m_reg_a] + 
-                emulator.m_gpr[curr_instr.m_reg_b] + 
-                curr_instr.m_disp
-              ) == tim_cfg
-            ) {
-              if (timer_config_map.find(emulator.m_gpr[curr_instr.m_reg_c]) != timer_config_map.end()) {
-                timer_config = timer_config_map[emulator.m_gpr[curr_instr.m_reg_c]];
-              } else {
-                std::cerr << "Greska: Nevalidna vrednost za konfiguraciju tajmera" << std::endl;
-              }
-            }
-            writeWord(
-              readWord(emulator.m_gpr[curr_instr.m_reg_a] + emulator.m_gpr[curr_instr.m_reg_b] + curr_instr.m_disp),
-              emulator.m_gpr[curr_instr.m_reg_c]
-            );
-            break;
-          default:
-            break;
+          case StMod::MEM_REL: execStMemRel(curr_instr); break;
+          case StMod::MEM_IND_DISP: execStMemIndDisp(curr_instr); break;
+          case StMod::MEM_IND: execStMemInd(curr_instr); break;
+          default: break;
         }
         break;
       case OpCode::LD:
         switch (curr_instr.m_mod) {
-          case LdMod::GPR_DIR:
-            // gpr[A]<=csr[B];
-            emulator.m_gpr[curr_instr.m_reg_a] = emulator.m_csr[curr_instr.m_reg_b];
-            break;
-          case LdMod::GPR_PC_REL:
-            // gpr[A]<=gpr[B]+D;
-            emulator.m_gpr[curr_instr.m_reg_a] = emulator.m_gpr[curr_instr.m_reg_b] + curr_instr.m_disp;
-            break;
-          case LdMod::GPR_MEM_IND:
-            // gpr[A]<=mem32[gpr[B]+gpr[C]+D];
-            emulator.m_gpr[curr_instr.m_reg_a] = readWord(
-              emulator.m_gpr[curr_instr.m_reg_b] + emulator.m_gpr[curr_instr.m_reg_c] + curr_instr.m_disp
-            );
-            break;
-          case LdMod::GPR_MEM_IND_DISP:
-            // gpr[A]<=mem32[gpr[B]]; gpr[B]<=gpr[B]+D;
-            emulator.m_gpr[curr_instr.m_reg_a] = readWord(emulator.m_gpr[curr_instr.m_reg_b]);
-            emulator.m_gpr[curr_instr.m_reg_b] = emulator.m_gpr[curr_instr.m_reg_b] + curr_instr.m_disp;
-            break;
-          case LdMod::CSR_DIR:
-            // csr[A]<=gpr[B]
-            emulator.m_csr[curr_instr.m_reg_a] = emulator.m_gpr[curr_instr.m_reg_b];
-            break;
-          case LdMod::CSR_PC_REL:
-            // csr[A]<=csr[B]|D;
-            emulator.m_csr[curr_instr.m_reg_a] = emulator.m_gpr[curr_instr.m_reg_b] | curr_instr.m_disp;
-            break;
-          case LdMod::CSR_MEM_IND:
-            // csr[A]<=mem32[gpr[B]+gpr[C]+D];
-            emulator.m_csr[curr_instr.m_reg_a] = readWord(
-              emulator.m_gpr[curr_instr.m_reg_b] + emulator.m_gpr[curr_instr.m_reg_c] + curr_instr.m_disp
-            );
-            break;
-          case LdMod::CSR_MEM_IND_DISP:
-            // csr[A]<=mem32[gpr[B]]; gpr[B]<=gpr[B]+D;
-            emulator.m_csr[curr_instr.m_reg_a] = readWord(emulator.m_gpr[curr_instr.m_reg_b]);
-            emulator.m_gpr[curr_instr.m_reg_b] = emulator.m_gpr[curr_instr.m_reg_b] + curr_instr.m_disp;
-            break;
-          default:
-            break;
+          case LdMod::GPR_DIR: execLdGprDir(curr_instr); break;
+          case LdMod::GPR_PC_REL: execLdGprPcRel(curr_instr); break;
+          case LdMod::GPR_MEM_IND: execLdGprMemInd(curr_instr); break;
+          case LdMod::GPR_MEM_IND_DISP: execLdGprMemIndDisp(curr_instr); break;
+          case LdMod::CSR_DIR: execLdCsrDir(curr_instr); break;
+          case LdMod::CSR_PC_REL: execLdCsrPcRel(curr_instr); break;
+          case LdMod::CSR_MEM_IND: execLdCsrMemInd(curr_instr); break;
+          case LdMod::CSR_MEM_IND_DISP: execLdCsrMemIndDisp(curr_instr); break;
+          default: break;
         }
         break;
       default:
         break;
     }
-    char c = getc(stdin);
-    if (c != EOF && (emulator.m_csr[Csr::STATUS] & INTERRUPT_MASK) == 0 && 
-        (emulator.m_csr[Csr::STATUS] & TERMINAL_MASK) == 0) {
-      emulator.m_mem32[term_in] = static_cast<uint8_t>(c);
-      push(emulator.m_csr[Csr::STATUS]);
-      push(emulator.m_gpr[PC]);
-      emulator.m_csr[Csr::CAUSE] = 0x00000003;
-      emulator.m_csr[Csr::STATUS] = emulator.m_csr[Csr::STATUS] | INTERRUPT_MASK;
-      emulator.m_gpr[PC] = emulator.m_csr[Csr::HANDLER];
+    handleInterrupts();
+  } while(curr_instr.m_oc != OpCode::HALT);
+}
+
+#elif defined(EMU_THREADED_DISPATCH)
+
+const char* DISPATCH_ENGINE = "threaded";
+
+/// Index of an instruction in the flat (oc, mod) dispatch table.
+#define DISPATCH_NDX(oc, mod) (((oc) << 4) | (mod))
+
+/// Every handler ends with its own fetch and indirect jump, so the host
+/// branch predictor sees one dispatch site per guest instruction kind.
+#define DISPATCH() \
+  do { \
+    curr_instr = loadInstr(emulator->m_gpr[PC]); \
+    emulator->m_instr_cnt++; \
+    instrHooks<HOOKS>(emulator->m_gpr[PC] - INSTR_SIZE, curr_instr); \
+    goto *dispatch_table[DISPATCH_NDX(curr_instr.m_oc, curr_instr.m_mod)]; \
+  } while (0)
+
+#define NEXT() \
+  do { \
+    handleInterrupts(); \
+    DISPATCH(); \
+  } while (0)
+
+template<uint32_t HOOKS>
+void runEngine() {
+  void* dispatch_table[256];
+  for (uint32_t i = 0; i < 256; i++) {
+    dispatch_table[i] = &&op_nop;
+  }
+  for (uint32_t mod = 0; mod < 16; mod++) {
+    dispatch_table[DISPATCH_NDX(OpCode::HALT, mod)] = &&op_halt;
+    dispatch_table[DISPATCH_NDX(OpCode::INT, mod)] = &&op_int;
+    dispatch_table[DISPATCH_NDX(OpCode::XCHG, mod)] = &&op_xchg;
+  }
+  dispatch_table[DISPATCH_NDX(OpCode::CALL, CallMod::CALL_PC_REL)] = &&op_call_pc_rel;
+  dispatch_table[DISPATCH_NDX(OpCode::CALL, CallMod::CALL_MEM_REL)] = &&op_call_mem_rel;
+  dispatch_table[DISPATCH_NDX(OpCode::JMP, JmpMod::JMP_PC_REL)] = &&op_jmp_pc_rel;
+  dispatch_table[DISPATCH_NDX(OpCode::JMP, JmpMod::BEQ_PC_REL)] = &&op_beq_pc_rel;
+  dispatch_table[DISPATCH_NDX(OpCode::JMP, JmpMod::BNE_PC_REL)] = &&op_bne_pc_rel;
+  dispatch_table[DISPATCH_NDX(OpCode::JMP, JmpMod::BGT_PC_REL)] = &&op_bgt_pc_rel;
+  dispatch_table[DISPATCH_NDX(OpCode::JMP, JmpMod::JMP_MEM_REL)] = &&op_jmp_mem_rel;
+  dispatch_table[DISPATCH_NDX(OpCode::JMP, JmpMod::BEQ_MEM_REL)] = &&op_beq_mem_rel;
+  dispatch_table[DISPATCH_NDX(OpCode::JMP, JmpMod::BNE_MEM_REL)] = &&op_bne_mem_rel;
+  dispatch_table[DISPATCH_NDX(OpCode::JMP, JmpMod::BGT_MEM_REL)] = &&op_bgt_mem_rel;
+  dispatch_table[DISPATCH_NDX(OpCode::ARITHMETIC, ArithmeticMod::ADD)] = &&op_add;
+  dispatch_table[DISPATCH_NDX(OpCode::ARITHMETIC, ArithmeticMod::SUB)] = &&op_sub;
+  dispatch_table[DISPATCH_NDX(OpCode::ARITHMETIC, ArithmeticMod::MUL)] = &&op_mul;
+  dispatch_table[DISPATCH_NDX(OpCode::ARITHMETIC, ArithmeticMod::DIV)] = &&op_div;
+  dispatch_table[DISPATCH_NDX(OpCode::LOGIC, LogicMod::NOT)] = &&op_not;
+  dispatch_table[DISPATCH_NDX(OpCode::LOGIC, LogicMod::AND)] = &&op_and;
+  dispatch_table[DISPATCH_NDX(OpCode::LOGIC, LogicMod::OR)] = &&op_or;
+  dispatch_table[DISPATCH_NDX(OpCode::LOGIC, LogicMod::XOR)] = &&op_xor;
+  dispatch_table[DISPATCH_NDX(OpCode::SHIFT, ShiftMod::SHL)] = &&op_shl;
+  dispatch_table[DISPATCH_NDX(OpCode::SHIFT, ShiftMod::SHR)] = &&op_shr;
+  dispatch_table[DISPATCH_NDX(OpCode::ST, StMod::MEM_REL)] = &&op_st_mem_rel;
+  dispatch_table[DISPATCH_NDX(OpCode::ST, StMod::MEM_IND_DISP)] = &&op_st_mem_ind_disp;
+  dispatch_table[DISPATCH_NDX(OpCode::ST, StMod::MEM_IND)] = &&op_st_mem_ind;
+  dispatch_table[DISPATCH_NDX(OpCode::LD, LdMod::GPR_DIR)] = &&op_ld_gpr_dir;
+  dispatch_table[DISPATCH_NDX(OpCode::LD, LdMod::GPR_PC_REL)] = &&op_ld_gpr_pc_rel;
+  dispatch_table[DISPATCH_NDX(OpCode::LD, LdMod::GPR_MEM_IND)] = &&op_ld_gpr_mem_ind;
+  dispatch_table[DISPATCH_NDX(OpCode::LD, LdMod::GPR_MEM_IND_DISP)] = &&op_ld_gpr_mem_ind_disp;
+  dispatch_table[DISPATCH_NDX(OpCode::LD, LdMod::CSR_DIR)] = &&op_ld_csr_dir;
+  dispatch_table[DISPATCH_NDX(OpCode::LD, LdMod::CSR_PC_REL)] = &&op_ld_csr_pc_rel;
+  dispatch_table[DISPATCH_NDX(OpCode::LD, LdMod::CSR_MEM_IND)] = &&op_ld_csr_mem_ind;
+  dispatch_table[DISPATCH_NDX(OpCode::LD, LdMod::CSR_MEM_IND_DISP)] = &&op_ld_csr_mem_ind_disp;
+
+  Instruction curr_instr;
+  DISPATCH();
+
+  op_nop: NEXT();
+  op_int: execInt(curr_instr); NEXT();
+  op_call_pc_rel: execCallPcRel(curr_instr); NEXT();
+  op_call_mem_rel: execCallMemRel(curr_instr); NEXT();
+  op_jmp_pc_rel: execJmpPcRel(curr_instr); NEXT();
+  op_beq_pc_rel: execBeqPcRel(curr_instr); NEXT();
+  op_bne_pc_rel: execBnePcRel(curr_instr); NEXT();
+  op_bgt_pc_rel: execBgtPcRel(curr_instr); NEXT();
+  op_jmp_mem_rel: execJmpMemRel(curr_instr); NEXT();
+  op_beq_mem_rel: execBeqMemRel(curr_instr); NEXT();
+  op_bne_mem_rel: execBneMemRel(curr_instr); NEXT();
+  op_bgt_mem_rel: execBgtMemRel(curr_instr); NEXT();
+  op_xchg: execXchg(curr_instr); NEXT();
+  op_add: execAdd(curr_instr); NEXT();
+  op_sub: execSub(curr_instr); NEXT();
+  op_mul: execMul(curr_instr); NEXT();
+  op_div: execDiv(curr_instr); NEXT();
+  op_not: execNot(curr_instr); NEXT();
+  op_and: execAnd(curr_instr); NEXT();
+  op_or: execOr(curr_instr); NEXT();
+  op_xor: execXor(curr_instr); NEXT();
+  op_shl: execShl(curr_instr); NEXT();
+  op_shr: execShr(curr_instr); NEXT();
+  op_st_mem_rel: execStMemRel(curr_instr); NEXT();
+  op_st_mem_ind_disp: execStMemIndDisp(curr_instr); NEXT();
+  op_st_mem_ind: execStMemInd(curr_instr); NEXT();
+  op_ld_gpr_dir: execLdGprDir(curr_instr); NEXT();
+  op_ld_gpr_pc_rel: execLdGprPcRel(curr_instr); NEXT();
+  op_ld_gpr_mem_ind: execLdGprMemInd(curr_instr); NEXT();
+  op_ld_gpr_mem_ind_disp: execLdGprMemIndDisp(curr_instr); NEXT();
+  op_ld_csr_dir: execLdCsrDir(curr_instr); NEXT();
+  op_ld_csr_pc_rel: execLdCsrPcRel(curr_instr); NEXT();
+  op_ld_csr_mem_ind: execLdCsrMemInd(curr_instr); NEXT();
+  op_ld_csr_mem_ind_disp: execLdCsrMemIndDisp(curr_instr); NEXT();
+  op_halt:
+    handleInterrupts();
+}
+
+#undef NEXT
+#undef DISPATCH
+#undef DISPATCH_NDX
+
+#else
+
+const char* DISPATCH_ENGINE = "block";
+
+/// Blocks are cut at this length and never span a page, so invalidation
+/// only has to look at the pages that hold translated slots.
+const uint32_t MAX_BLOCK_INSTRS = 64;
+/// Chained blocks run back to back, interrupts are checked in between or
+/// as soon as the poll deadline is reached.
+const uint32_t BLOCK_CHAIN_LIMIT = 16;
+
+InstrHandler instr_handlers[256];
+/// Batch workers share the table, it is filled by whichever one starts first.
+std::once_flag instr_handlers_once;
+
+void execNop(const Instruction&) {}
+
+void initInstrHandlers() {
+  for (uint32_t i = 0; i < 256; i++) {
+    instr_handlers[i] = execNop;
+  }
+  for (uint32_t mod = 0; mod < 16; mod++) {
+    instr_handlers[(OpCode::INT << 4) | mod] = execInt;
+    instr_handlers[(OpCode::XCHG << 4) | mod] = execXchg;
+  }
+  instr_handlers[(OpCode::CALL << 4) | CallMod::CALL_PC_REL] = execCallPcRel;
+  instr_handlers[(OpCode::CALL << 4) | CallMod::CALL_MEM_REL] = execCallMemRel;
+  instr_handlers[(OpCode::JMP << 4) | JmpMod::JMP_PC_REL] = execJmpPcRel;
+  instr_handlers[(OpCode::JMP << 4) | JmpMod::BEQ_PC_REL] = execBeqPcRel;
+  instr_handlers[(OpCode::JMP << 4) | JmpMod::BNE_PC_REL] = execBnePcRel;
+  instr_handlers[(OpCode::JMP << 4) | JmpMod::BGT_PC_REL] = execBgtPcRel;
+  instr_handlers[(OpCode::JMP << 4) | JmpMod::JMP_MEM_REL] = execJmpMemRel;
+  instr_handlers[(OpCode::JMP << 4) | JmpMod::BEQ_MEM_REL] = execBeqMemRel;
+  instr_handlers[(OpCode::JMP << 4) | JmpMod::BNE_MEM_REL] = execBneMemRel;
+  instr_handlers[(OpCode::JMP << 4) | JmpMod::BGT_MEM_REL] = execBgtMemRel;
+  instr_handlers[(OpCode::ARITHMETIC << 4) | ArithmeticMod::ADD] = execAdd;
+  instr_handlers[(OpCode::ARITHMETIC << 4) | ArithmeticMod::SUB] = execSub;
+  instr_handlers[(OpCode::ARITHMETIC << 4) | ArithmeticMod::MUL] = execMul;
+  instr_handlers[(OpCode::ARITHMETIC << 4) | ArithmeticMod::DIV] = execDiv;
+  instr_handlers[(OpCode::LOGIC << 4) | LogicMod::NOT] = execNot;
+  instr_handlers[(OpCode::LOGIC << 4) | LogicMod::AND] = execAnd;
+  instr_handlers[(OpCode::LOGIC << 4) | LogicMod::OR] = execOr;
+  instr_handlers[(OpCode::LOGIC << 4) | LogicMod::XOR] = execXor;
+  instr_handlers[(OpCode::SHIFT << 4) | ShiftMod::SHL] = execShl;
+  instr_handlers[(OpCode::SHIFT << 4) | ShiftMod::SHR] = execShr;
+  instr_handlers[(OpCode::ST << 4) | StMod::MEM_REL] = execStMemRel;
+  instr_handlers[(OpCode::ST << 4) | StMod::MEM_IND_DISP] = execStMemIndDisp;
+  instr_handlers[(OpCode::ST << 4) | StMod::MEM_IND] = execStMemInd;
+  instr_handlers[(OpCode::LD << 4) | LdMod::GPR_DIR] = execLdGprDir;
+  instr_handlers[(OpCode::LD << 4) | LdMod::GPR_PC_REL] = execLdGprPcRel;
+  instr_handlers[(OpCode::LD << 4) | LdMod::GPR_MEM_IND] = execLdGprMemInd;
+  instr_handlers[(OpCode::LD << 4) | LdMod::GPR_MEM_IND_DISP] = execLdGprMemIndDisp;
+  instr_handlers[(OpCode::LD << 4) | LdMod::CSR_DIR] = execLdCsrDir;
+  instr_handlers[(OpCode::LD << 4) | LdMod::CSR_PC_REL] = execLdCsrPcRel;
+  instr_handlers[(OpCode::LD << 4) | LdMod::CSR_MEM_IND] = execLdCsrMemInd;
+  instr_handlers[(OpCode::LD << 4) | LdMod::CSR_MEM_IND_DISP] = execLdCsrMemIndDisp;
+}
+
+InstrHandler instrHandler(const Instruction& a_instr) {
+  return instr_handlers[(a_instr.m_oc << 4) | a_instr.m_mod];
+}
+
+/// Control transfers and every instruction that can write pc end a block.
+bool endsBlock(const Instruction& a_instr) {
+  switch (a_instr.m_oc) {
+    case OpCode::HALT:
+    case OpCode::INT:
+    case OpCode::CALL:
+    case OpCode::JMP:
+      return true;
+    case OpCode::XCHG:
+      return a_instr.m_reg_b == PC || a_instr.m_reg_c == PC;
+    case OpCode::ARITHMETIC:
+    case OpCode::LOGIC:
+    case OpCode::SHIFT:
+      return a_instr.m_reg_a == PC;
+    case OpCode::ST:
+      return a_instr.m_mod == StMod::MEM_IND_DISP && a_instr.m_reg_a == PC;
+    case OpCode::LD:
+      switch (a_instr.m_mod) {
+        case LdMod::GPR_DIR:
+        case LdMod::GPR_PC_REL:
+        case LdMod::GPR_MEM_IND:
+          return a_instr.m_reg_a == PC;
+        case LdMod::GPR_MEM_IND_DISP:
+          return a_instr.m_reg_a == PC || a_instr.m_reg_b == PC;
+        case LdMod::CSR_MEM_IND_DISP:
+          return a_instr.m_reg_b == PC;
+        default:
+          return false;
+      }
+    default:
+      return false;
+  }
+}
+
+void markTranslated(uint32_t a_addr) {
+  DecodedPage* page = decodedPage(a_addr >> PAGE_BITS);
+  uint32_t first_slot = (a_addr & PAGE_OFFSET_MASK) / INSTR_SIZE;
+  uint32_t last_slot = ((a_addr & PAGE_OFFSET_MASK) + INSTR_SIZE - 1) / INSTR_SIZE;
+  for (uint32_t slot = first_slot; slot <= last_slot; slot++) {
+    page->m_translated.set(slot);
+  }
+}
+
+Block* translateBlock(uint32_t a_pc) {
+  if (decodedPage(a_pc >> PAGE_BITS)->m_self_modifying) {
+    return nullptr;
+  }
+
+  auto block = std::make_unique<Block>(a_pc);
+  uint32_t pc = a_pc;
+  while (block->m_instrs.size() < MAX_BLOCK_INSTRS && 
+         (pc >> PAGE_BITS) == (a_pc >> PAGE_BITS) &&
+         wordInsidePage(pc)) {
+    markTranslated(pc);
+    Instruction instr = loadInstr(pc);
+    block->m_instrs.emplace_back(instrHandler(instr), instr);
+    if (endsBlock(instr)) {
+      block->m_ends_with_halt = instr.m_oc == OpCode::HALT;
+      break;
+    }
+  }
+  if (block->m_instrs.empty()) {
+    return nullptr;
+  }
+  block->m_end_pc = pc;
+
+  Block* result = block.get();
+  emulator->m_block_cache.m_blocks[a_pc] = std::move(block);
+  return result;
+}
+
+/// Follows the chain of a_prev when it leads to a_pc, otherwise looks the
+/// block up or translates it and links it to a_prev.
+Block* nextBlock(Block* a_prev, uint32_t a_pc) {
+  if (a_prev != nullptr) {
+    if (a_prev->m_taken != nullptr && a_prev->m_taken->m_start_pc == a_pc) {
+      return a_prev->m_taken;
+    }
+    if (a_prev->m_fallthrough != nullptr && a_prev->m_fallthrough->m_start_pc == a_pc) {
+      return a_prev->m_fallthrough;
     }
-    end_time = std::chrono::high_resolution_clock::now();
-    if (timer_config != -1 && (emulator.m_csr[Csr::STATUS] & INTERRUPT_MASK) == 0 && 
-        (emulator.m_csr[Csr::STATUS] & TIMER_MASK) == 0) {
-      auto elapsed_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
-      if (elapsed_time - timer_config >= -5) {
-        timer_triggered = true;
+  }
+
+  Block* block = nullptr;
+  auto it = emulator->m_block_cache.m_blocks.find(a_pc);
+  if (it != emulator->m_block_cache.m_blocks.end()) {
+    block = it->second.get();
+  } else {
+    block = translateBlock(a_pc);
+  }
+
+  if (a_prev != nullptr && block != nullptr) {
+    if (a_pc == a_prev->m_end_pc) {
+      a_prev->m_fallthrough = block;
+    } else {
+      a_prev->m_taken = block;
+    }
+  }
+  return block;
+}
+
+/// Drops every block, chained pointers included. Runs between blocks only.
+void flushBlocks() {
+  emulator->m_block_cache.m_blocks.clear();
+  for (auto& [page_num, page] : emulator->m_decode_cache.m_pages) {
+    page->m_translated.reset();
+  }
+  emulator->m_block_cache.m_flush_pending = false;
+}
+
+/// Returns true when the block ran up to and including a halt. A store into
+/// translated code stops the block right after the storing instruction, a
+/// reached poll deadline stops it before the next one.
+template<uint32_t HOOKS>
+bool runBlock(const Block& a_block) {
+  uint32_t pc = a_block.m_start_pc;
+  for (const BlockInstr& block_instr : a_block.m_instrs) {
+    if (emulator->m_instr_cnt >= emulator->m_next_poll_instr) {
+      return false;
+    }
+    emulator->m_gpr[PC] = pc + WORD_SIZE;
+    emulator->m_instr_cnt++;
+    instrHooks<HOOKS>(pc, block_instr.m_instr);
+    pc+= WORD_SIZE;
+    block_instr.m_handler(block_instr.m_instr);
+    if (emulator->m_block_cache.m_flush_pending) {
+      return false;
+    }
+  }
+  return a_block.m_ends_with_halt;
+}
+
+template<uint32_t HOOKS>
+void runEngine() {
+  std::call_once(instr_handlers_once, initInstrHandlers);
+  Block* block = nullptr;
+  bool halted = false;
+  while (!halted) {
+    for (uint32_t chained = 0; chained < BLOCK_CHAIN_LIMIT && !halted; chained++) {
+      if constexpr ((HOOKS & HOOK_TRACE) != 0) {
+        // replay delivers interrupts at exact instruction counts
+        block = emulator->m_trace.m_replaying ? nullptr : nextBlock(block, emulator->m_gpr[PC]);
+      } else {
+        block = nextBlock(block, emulator->m_gpr[PC]);
       }
-      if (elapsed_time >= timer_config) {
-        push(emulator.m_csr[Csr::STATUS]);
-        push(emulator.m_gpr[PC]);
-        emulator.m_csr[Csr::CAUSE] = 0x00000002;
-        emulator.m_csr[Csr::STATUS] = emulator.m_csr[Csr::STATUS] | INTERRUPT_MASK;
-        emulator.m_gpr[PC] = emulator.m_csr[Csr::HANDLER];
-        start_time = std::chrono::high_resolution_clock::now();
+      if (block == nullptr) {
+        // self modifying page, interpret a single instruction
+        Instruction curr_instr = loadInstr(emulator->m_gpr[PC]);
+        emulator->m_instr_cnt++;
+        instrHooks<HOOKS>(emulator->m_gpr[PC] - INSTR_SIZE, curr_instr);
+        instrHandler(curr_instr)(curr_instr);
+        halted = curr_instr.m_oc == OpCode::HALT;
+        break;
+      }
+      halted = runBlock<HOOKS>(*block);
+      if (emulator->m_block_cache.m_flush_pending ||
+          emulator->m_instr_cnt >= emulator->m_next_poll_instr) {
+        break;
       }
     }
-  } while(curr_instr.m_oc != OpCode::HALT);
+    handleInterrupts();
+    if (emulator->m_block_cache.m_flush_pending) {
+      flushBlocks();
+      block = nullptr;
+    }
+  }
+}
+
+#endif
+
+template<uint32_t HOOKS>
+void executeWithHooks(uint32_t a_hooks) {
+  if constexpr (HOOKS == 0) {
+    runEngine<0>();
+  } else if (a_hooks == HOOKS) {
+    runEngine<HOOKS>();
+  } else {
+    executeWithHooks<HOOKS - 1>(a_hooks);
+  }
+}
+
+void execute() {
+  uint32_t hooks = 0;
+  if (emulator->m_stats.m_enabled) {
+    hooks|= HOOK_STATS;
+  }
+  if (emulator->m_profiler.m_enabled) {
+    hooks|= HOOK_PROFILE;
+  }
+  if (emulator->m_call_graph.m_enabled) {
+    hooks|= HOOK_CALL_GRAPH;
+  }
+  if (emulator->m_trace.m_recording || emulator->m_trace.m_replaying) {
+    hooks|= HOOK_TRACE;
+  }
+  // counters and traces see every instruction, nothing is skipped for them
+  emulator->m_idle.m_enabled = emulator->m_idle.m_enabled && hooks == 0;
+  executeWithHooks<HOOK_ALL>(hooks);
+}
+
+bool startRun() {
+  TerminalState& terminal = emulator->m_terminal;
+  if (!terminal.m_input_file.empty() && !loadKeyScript(terminal.m_input_file, terminal.m_input)) {
+    return false;
+  }
+  TraceState& trace = emulator->m_trace;
+  if (trace.m_replaying) {
+    return loadTrace(trace);
+  }
+  if (trace.m_recording && !startTraceWriter(trace)) {
+    std::cerr << "Greska prilikom otvaranja fajla: " << trace.m_file << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool finishRun() {
+  if (!emulator->m_snapshot.m_file.empty()) {
+    takeSnapshot();
+  }
+  finishTraceInstr();
+  bool written = !emulator->m_snapshot.m_failed;
+  TraceState& trace = emulator->m_trace;
+  if (trace.m_recording) {
+    written = stopTraceWriter(trace, emulator->m_instr_cnt) && written;
+  } else if (trace.m_replaying) {
+    finishReplay(trace, emulator->m_instr_cnt);
+  }
+  return written;
+}
+
+bool writeHeadlessOutput() {
+  const TerminalState& terminal = emulator->m_terminal;
+  const std::string& output = terminal.m_output;
+  if (terminal.m_output_file.empty()) {
+    std::cout.write(output.data(), output.size());
+    return true;
+  }
+  std::ofstream out(terminal.m_output_file, std::ios::binary);
+  return static_cast<bool>(out.write(output.data(), output.size()));
+}
+
+void showBenchResult(double a_seconds) {
+  std::cerr << "Dispatch engine: " << DISPATCH_ENGINE << "\n"
+    << "Executed instructions: " << emulator->m_instr_cnt << "\n"
+    << "Elapsed time: " << std::fixed << std::setprecision(6) << a_seconds << " s\n"
+    << "Instructions per second: " << std::setprecision(0) 
+    << (a_seconds > 0 ? emulator->m_instr_cnt / a_seconds : 0.0) << std::endl;
+  if (emulator->m_idle.m_skipped_instrs != 0) {
+    std::cerr << "Fast-forwarded instructions: " << emulator->m_idle.m_skipped_instrs << std::endl;
+  }
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    std::cerr << "Peak RSS: " << usage.ru_maxrss << " KiB" << std::endl;
+  }
 }
 
 int main(int argc, char* argv[]) {
   std::string input_file;
+  std::string restore_file;
+  BatchConfig batch_config;
+  bool bench_mode = false;
+  auto instance = std::make_unique<Emulator>();
+  emulator = instance.get();
 
-  if (handleArguments(argc, argv, input_file) != 0) {
+  if (handleArguments(argc, argv, input_file, restore_file, batch_config, bench_mode) != 0) {
     return 1;
   }
 
-  if (parseHexFile(input_file) != 0) {
-    return 1;
+  if (!batch_config.m_list_file.empty()) {
+    batch_config.m_timer = emulator->m_timer;
+    batch_config.m_idle = emulator->m_idle.m_enabled;
+    batch_config.m_input_file = emulator->m_terminal.m_input_file;
+    batch_config.m_snapshot = emulator->m_snapshot;
+    batch_config.m_trace_recording = emulator->m_trace.m_recording;
+    batch_config.m_trace_replaying = emulator->m_trace.m_replaying;
+    batch_config.m_trace_file = emulator->m_trace.m_file;
+    initDevices();
+    return runBatch(batch_config);
   }
 
-  initTerminal();
+  if (!restore_file.empty()) {
+    if (!restoreSnapshot(*emulator, restore_file)) {
+      std::cerr << "Greska: Neispravan snimak stanja: " << restore_file << std::endl;
+      return 1;
+    }
+  } else {
+    if (loadProgram(emulator->m_mem32, input_file) != 0) {
+      return 1;
+    }
+    startProgram(PROGRAM_START);
+  }
+
+  initDevices();
+  if (!startRun()) {
+    return 1;
+  }
+  TerminalState& terminal = emulator->m_terminal;
+  TraceState& trace = emulator->m_trace;
+  bool use_tty = !terminal.m_headless && !trace.m_replaying;
+  if (use_tty) {
+    initTerminal();
+    startTerminalReader();
+  }
 
+  auto start_time = std::chrono::high_resolution_clock::now();
   execute();
+  auto end_time = std::chrono::high_resolution_clock::now();
+  if (use_tty) {
+    stopTerminalReader();
+  }
+  flushTerminalOutput();
+  if (terminal.m_headless && !writeHeadlessOutput()) {
+    std::cerr << "Greska prilikom pisanja fajla: " << terminal.m_output_file << "\n";
+    return 1;
+  }
+
+  if (!finishRun()) {
+    return 1;
+  }
 
   showEmulatorState();
 
+  double seconds = std::chrono::duration<double>(end_time - start_time).count();
+  if (emulator->m_stats.m_enabled) {
+    showStats(emulator->m_stats, DISPATCH_ENGINE, emulator->m_instr_cnt, seconds);
+  } else if (bench_mode) {
+    showBenchResult(seconds);
+  }
+
+  if (emulator->m_profiler.m_enabled && showProfile(emulator->m_profiler) != 0) {
+    return 1;
+  }
+
+  if (emulator->m_call_graph.m_enabled) {
+    finishCallGraph(emulator->m_call_graph, emulator->m_instr_cnt);
+    if (showCallGraph(emulator->m_call_graph, emulator->m_profiler.m_symtab_file) != 0) {
+      return 1;
+    }
+  }
+
+  if (trace.m_replaying) {
+    if (trace.m_diverged) {
+      std::cerr << trace.m_divergence << std::endl;
+      return 1;
+    }
+    std::cerr << "Replay matched " << emulator->m_instr_cnt << " instructions" << std::endl;
+  }
+
   return 0;
 }
\ No newline at end of file
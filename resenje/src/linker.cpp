@@ -1,105 +1,286 @@
+#include "../inc/archive_file.hpp"
 #include "../inc/common.hpp"
+#include "../inc/image.hpp"
+#include "../inc/mapped_file.hpp"
+#include "../inc/name_table.hpp"
+#include "../inc/object_file.hpp"
 #include "../inc/types.hpp"
+#include "../inc/work_pool.hpp"
 #include <algorithm>
+#include <charconv>
 #include <fstream>
 #include <iostream>
-#include <sstream>
-
-SymbolTable linker_sym_tab;
+#include <memory>
+#include <string_view>
+
+/// Tables of one input object. Inputs are parsed in parallel and merged
+/// into the linker tables in command line order. The input stays alive
+/// until the output is written, section views point into its mapping or
+/// into the bytes decoded from a text object. An archive input only has its
+/// index read, m_extracted marks the members already pulled into the link.
+struct LinkerInput {
+  std::string m_file_name;
+  MappedFile m_file;
+  bool m_is_archive = false;
+  ArchiveIndex m_archive;
+  std::vector<bool> m_extracted;
+  SectionDataTable m_text_data;
+  SymbolTable m_sym_tab;
+  SectionRelasTable m_section_relas_table;
+  SectionViewTable m_section_views;
+  std::vector<std::string> m_sections;
+  std::string m_error;
+};
+
+/// Linker symbol indexed by the id of its name. m_sctn is the id of its
+/// section, symbol updates and relocations never hash a string.
+struct LinkerSym {
+  Sym m_sym;
+  NameId m_sctn = 0;
+  bool m_present = false;
+};
+
+struct LinkerRela {
+  uint32_t m_offset;
+  NameId m_sym;
+  int32_t m_addend;
+};
+
+/// Output section indexed by the id of its name. Input pieces are copied
+/// into m_data once the layout is known.
+struct LinkerSection {
+  std::vector<SectionView> m_pieces;
+  std::vector<LinkerRela> m_relas;
+  std::vector<uint8_t> m_data;
+  uint32_t m_size = 0;
+  uint32_t m_addr = 0;
+  bool m_present = false;
+};
+
+/// Symbol of the input being merged, with its name and section interned.
+struct InputSym {
+  Sym* m_sym;
+  NameId m_id;
+  NameId m_sctn;
+};
+
+NameTable linker_sym_names;
+NameTable linker_sctn_names;
+std::vector<LinkerSym> linker_syms;
+std::vector<LinkerSection> linker_section_table;
 SectionPlaceTable linker_section_place_table;
-SectionRelasTable linker_section_relas_table;
-SectionDataTable linker_section_data_table;
-std::vector<std::string> linker_sections;
+std::vector<NameId> linker_sections;
+std::vector<std::unique_ptr<LinkerInput>> linker_inputs;
 
 const std::size_t SCTN_START_NDX_PLACE_DIR = 7;
+const std::size_t SYMTAB_FILE_NDX = 8;
+const std::size_t JOBS_ARG_OFF = 7;
+
+bool nextLine(std::string_view& a_text, std::string_view& a_line) {
+  if (a_text.empty()) {
+    a_line = std::string_view();
+    return false;
+  }
+  std::size_t eol = a_text.find('\n');
+  a_line = a_text.substr(0, eol);
+  a_text.remove_prefix(eol == std::string_view::npos ? a_text.size() : eol + 1);
+  return true;
+}
+
+std::string_view fieldUntilSpace(std::string_view a_line, std::size_t a_off) {
+  return a_line.substr(a_off, a_line.find(' ', a_off) - a_off);
+}
+
+/// Lookups never insert, the tables are shared by the parsing threads.
+template<typename T>
+T lookupName(const std::unordered_map<std::string, T>& a_map, std::string_view a_name) {
+  auto it = a_map.find(std::string(a_name));
+  return it != a_map.end() ? it->second : T();
+}
 
-void parseSymTabEntry(const std::string& a_line, SymbolTable& a_input_sym_tab) {
-  uint32_t num = std::stoul(a_line.substr(SymTabLayout::NUM_OFF, SymTabLayout::NUM_WIDTH));
-  uint32_t val = std::stoul(a_line.substr(SymTabLayout::VAL_OFF, SymTabLayout::VAL_WIDTH), nullptr, 16);
-  std::size_t type_last_char_off = a_line.find(" ", SymTabLayout::TYPE_OFF);
-  SymbolType type = 
-    sym_type_to_str_map[a_line.substr(SymTabLayout::TYPE_OFF, type_last_char_off - SymTabLayout::TYPE_OFF)];
-  std::size_t bind_last_char_off = a_line.find(" ", SymTabLayout::BIND_OFF);
-  SymbolBinding bind = sym_bind_to_str_map[a_line.substr(SymTabLayout::BIND_OFF, bind_last_char_off - SymTabLayout::BIND_OFF)];
-  std::size_t sctn_name_last_char_off = a_line.find(" ", SymTabLayout::SCTN_OFF);
-  std::string sctn_name = a_line.substr(SymTabLayout::SCTN_OFF, sctn_name_last_char_off - SymTabLayout::SCTN_OFF);
-  std::string sym_name = a_line.substr(SymTabLayout::NAME_OFF);
+/// Fails unless the padded field holds exactly one number.
+template<typename T>
+bool parseNumber(std::string_view a_text, T& a_value, int a_base = 10) {
+  while (!a_text.empty() && a_text.front() == ' ') {
+    a_text.remove_prefix(1);
+  }
+  while (!a_text.empty() && (a_text.back() == ' ' || a_text.back() == '\r')) {
+    a_text.remove_suffix(1);
+  }
+  auto result = std::from_chars(a_text.data(), a_text.data() + a_text.size(), a_value, a_base);
+  return !a_text.empty() && result.ec == std::errc() && result.ptr == a_text.data() + a_text.size();
+}
+
+/// Numeric option values are decimal, or hexadecimal with a 0x prefix.
+template<typename T>
+bool parseOptionNumber(std::string_view a_text, T& a_value) {
+  if (a_text.size() > 2 && a_text[0] == '0' && (a_text[1] == 'x' || a_text[1] == 'X')) {
+    return parseNumber(a_text.substr(2), a_value, 16);
+  }
+  return parseNumber(a_text, a_value);
+}
+
+bool parseSymTabEntry(std::string_view a_line, SymbolTable& a_input_sym_tab) {
+  uint32_t num = 0;
+  uint32_t val = 0;
+  if (a_line.size() <= SymTabLayout::NAME_OFF ||
+      !parseNumber(a_line.substr(SymTabLayout::NUM_OFF, SymTabLayout::NUM_WIDTH), num) ||
+      !parseNumber(a_line.substr(SymTabLayout::VAL_OFF, SymTabLayout::VAL_WIDTH), val, 16)) {
+    return false;
+  }
+  SymbolType type = lookupName(sym_type_to_str_map, fieldUntilSpace(a_line, SymTabLayout::TYPE_OFF));
+  SymbolBinding bind = lookupName(sym_bind_to_str_map, fieldUntilSpace(a_line, SymTabLayout::BIND_OFF));
+  std::string sctn_name(fieldUntilSpace(a_line, SymTabLayout::SCTN_OFF));
+  std::string sym_name(a_line.substr(SymTabLayout::NAME_OFF));
   Sym sym = Sym(sym_name, bind, type, sctn_name, val, sctn_name == UNDEFINED_SCTN ? false : true);
   sym.m_index = num;
   a_input_sym_tab[sym_name] = sym;
+  return true;
 }
 
-void parseRelaEntry(
-  const std::string& a_line, 
+bool parseRelaEntry(
+  std::string_view a_line, 
   SectionRelasTable& a_input_section_relas_table, 
   const std::string& a_sctn_name
 ) {
-  uint32_t offset = std::stoul(a_line.substr(RelaLayout::OFFSET_OFF, RelaLayout::OFFSET_WIDTH), nullptr, 16);
-  std::size_t type_last_char_off = a_line.find(" ", RelaLayout::TYPE_OFF);
-  RelocationType type = 
-    rela_type_to_str_map[a_line.substr(RelaLayout::TYPE_OFF, type_last_char_off - RelaLayout::TYPE_OFF)];
-  std::size_t sym_name_last_char_off = a_line.find(" ", RelaLayout::SYMBOL_OFF);
-  std::string sym_name = a_line.substr(RelaLayout::SYMBOL_OFF, sym_name_last_char_off - RelaLayout::SYMBOL_OFF);
-  int32_t addend = std::stoi(a_line.substr(RelaLayout::ADDEND_OFF));
-  Rela rela = Rela(offset, sym_name, type, addend);
-  a_input_section_relas_table[a_sctn_name].push_back(rela);
-}
-
-void parseSectionContentLine(
-  const std::string& a_line, 
-  SectionDataTable& a_input_section_data_table, 
-  const std::string& a_sctn_name
-) {
-  std::istringstream iss(a_line);
-  std::string byte_representation;
-  while (iss >> byte_representation) {
-      uint8_t byte_val = static_cast<uint8_t>(std::stoul(byte_representation, nullptr, 16));
-      a_input_section_data_table[a_sctn_name].push_back(byte_val);
+  uint32_t offset = 0;
+  int32_t addend = 0;
+  if (a_line.size() <= RelaLayout::ADDEND_OFF ||
+      !parseNumber(a_line.substr(RelaLayout::OFFSET_OFF, RelaLayout::OFFSET_WIDTH), offset, 16) ||
+      !parseNumber(a_line.substr(RelaLayout::ADDEND_OFF), addend)) {
+    return false;
   }
+  RelocationType type = lookupName(rela_type_to_str_map, fieldUntilSpace(a_line, RelaLayout::TYPE_OFF));
+  std::string sym_name(fieldUntilSpace(a_line, RelaLayout::SYMBOL_OFF));
+  a_input_section_relas_table[a_sctn_name].emplace_back(offset, std::move(sym_name), type, addend);
+  return true;
 }
 
-int8_t parseLinkerInput(
-  const std::string& a_input_file, 
-  SymbolTable& a_input_sym_tab,
-  SectionRelasTable& a_input_section_relas_table,
-  SectionDataTable& a_input_section_data_table,
-  std::vector<std::string>& a_input_sections
-) {
-  std::ifstream in(a_input_file);
+bool parseSectionContentLine(std::string_view a_line, std::vector<uint8_t>& a_data) {
+  const char* pos = a_line.data();
+  const char* end = pos + a_line.size();
+  while (pos < end) {
+    if (*pos == ' ' || *pos == '\r') {
+      pos++;
+      continue;
+    }
+    uint8_t byte_val = 0;
+    auto result = std::from_chars(pos, end, byte_val, 16);
+    if (result.ec != std::errc()) {
+      return false;
+    }
+    a_data.push_back(byte_val);
+    pos = result.ptr;
+  }
+  return true;
+}
 
-  if (!in.is_open()) {
-      std::cerr << "Greska prilikom otvaranja fajla: " << a_input_file << "\n";
-      return 1;
+/// Objects are parsed in place. Binary objects leave section contents in
+/// a_data, text objects decode them into a_input. Runs on a worker thread,
+/// so errors are kept in a_input and reported by the merge.
+void parseInputData(LinkerInput& a_input, const uint8_t* a_data, std::size_t a_size) {
+  const uint8_t* data = a_data;
+  std::size_t size = a_size;
+  if (isObjectData(data, size)) {
+    if (!parseObjectFile(
+          data,
+          size,
+          a_input.m_sym_tab,
+          a_input.m_section_relas_table,
+          a_input.m_section_views,
+          a_input.m_sections)) {
+      a_input.m_error = "Greska: Neispravan objektni fajl " + a_input.m_file_name;
+    }
+    return;
   }
 
-  std::string line;
-  std::getline(in, line); /// #.symtab
-  std::getline(in, line); /// symtab header
+  std::string_view text(reinterpret_cast<const char*>(data), size);
+  std::string_view line;
+  nextLine(text, line); /// #.symtab
+  nextLine(text, line); /// symtab header
 
-  while (std::getline(in, line) && line[0] != '#') {
-      parseSymTabEntry(line, a_input_sym_tab);
+  while (nextLine(text, line) && !line.empty() && line[0] != '#') {
+    if (!parseSymTabEntry(line, a_input.m_sym_tab)) {
+      a_input.m_error = "Greska: Neispravan objektni fajl " + a_input.m_file_name;
+      return;
+    }
   }
 
   while(true) {
-    if (line.find(RELA_SCTN_PREFIX) != std::string::npos) {
-      std::string sctn_name = line.substr(RELA_SCTN_NAME_OFF);
-      std::getline(in, line); /// rela header
-      while (std::getline(in, line) && !line.empty() && line[0] != '#') {
-        parseRelaEntry(line, a_input_section_relas_table, sctn_name);
+    if (line.find(RELA_SCTN_PREFIX) != std::string_view::npos) {
+      std::string sctn_name(line.substr(RELA_SCTN_NAME_OFF));
+      nextLine(text, line); /// rela header
+      while (nextLine(text, line) && !line.empty() && line[0] != '#') {
+        if (!parseRelaEntry(line, a_input.m_section_relas_table, sctn_name)) {
+          a_input.m_error = "Greska: Neispravan objektni fajl " + a_input.m_file_name;
+          return;
+        }
       }
     } else if (!line.empty() && line[0] == '#'){
-      std::string sctn_name = line.substr(SCTN_NAME_OFF);
-      a_input_sections.push_back(sctn_name);
-      while (std::getline(in, line) && !line.empty() && line[0] != '#') {
-        parseSectionContentLine(line, a_input_section_data_table, sctn_name);
+      std::string sctn_name(line.substr(SCTN_NAME_OFF));
+      a_input.m_sections.push_back(sctn_name);
+      std::vector<uint8_t>& sctn_data = a_input.m_text_data[sctn_name];
+      while (nextLine(text, line) && !line.empty() && line[0] != '#') {
+        if (!parseSectionContentLine(line, sctn_data)) {
+          a_input.m_error = "Greska: Neispravan objektni fajl " + a_input.m_file_name;
+          return;
+        }
       }
     } else {
       break;
     }
   }
 
-  in.close();
-  return 0;
+  for (const auto& [sctn_name, relas] : a_input.m_section_relas_table) {
+    auto data_it = a_input.m_text_data.find(sctn_name);
+    std::size_t sctn_size = data_it != a_input.m_text_data.end() ? data_it->second.size() : 0;
+    for (const auto& rela : relas) {
+      if (static_cast<uint64_t>(rela.m_offset) + 4 > sctn_size) {
+        a_input.m_error = "Greska: Neispravan objektni fajl " + a_input.m_file_name;
+        return;
+      }
+    }
+  }
+
+  for (const auto& [sctn_name, sctn_data] : a_input.m_text_data) {
+    if (!sctn_data.empty()) {
+      a_input.m_section_views[sctn_name] = 
+        SectionView(sctn_data.data(), static_cast<uint32_t>(sctn_data.size()));
+    }
+  }
+}
+
+void parseLinkerInput(LinkerInput& a_input) {
+  if (!mapFile(a_input.m_file_name, a_input.m_file)) {
+      a_input.m_error = "Greska prilikom otvaranja fajla: " + a_input.m_file_name;
+      return;
+  }
+
+  if (isArchiveData(a_input.m_file.m_data, a_input.m_file.m_size)) {
+    a_input.m_is_archive = true;
+    if (!parseArchiveFile(a_input.m_file.m_data, a_input.m_file.m_size, a_input.m_archive)) {
+      a_input.m_error = "Greska: Neispravna arhiva " + a_input.m_file_name;
+    }
+    a_input.m_extracted.assign(a_input.m_archive.m_members.size(), false);
+    return;
+  }
+  parseInputData(a_input, a_input.m_file.m_data, a_input.m_file.m_size);
+}
+
+NameId symbolId(const std::string& a_name) {
+  NameId id = linker_sym_names.intern(a_name);
+  if (id >= linker_syms.size()) {
+    linker_syms.resize(id + 1);
+  }
+  return id;
+}
+
+NameId sectionId(const std::string& a_name) {
+  NameId id = linker_sctn_names.intern(a_name);
+  if (id >= linker_section_table.size()) {
+    linker_section_table.resize(id + 1);
+  }
+  return id;
 }
 
 bool sortAndValidatePlaceSections() {
@@ -113,7 +294,8 @@ bool sortAndValidatePlaceSections() {
 
   for (std::size_t i = 0; i < linker_section_place_table.size(); i++) {
     if (i != linker_section_place_table.size() - 1) {
-      std::uint32_t sctn_size = linker_section_data_table[linker_section_place_table[i].m_sctn_name].size();
+      std::uint32_t sctn_size = 
+        linker_section_table[sectionId(linker_section_place_table[i].m_sctn_name)].m_size;
       if (linker_section_place_table[i].m_addr + sctn_size > linker_section_place_table[i+1].m_addr) {
         std::cerr << "Greska: Preklapanje sekcija " << linker_section_place_table[i].m_sctn_name 
           << " i " << linker_section_place_table[i+1].m_sctn_name << " zbog -place opcije\n";
@@ -130,40 +312,34 @@ bool sortAndValidatePlaceSections() {
   return true;
 }
 
-bool hasConflictingSymbolDefinitions(
-  SymbolTable& a_input_sym_tab,
-  SymbolTable& a_existing_sym_tab
-) {
-  for(const auto& [sym_name, sym] : a_input_sym_tab) {
-    if (a_existing_sym_tab.find(sym_name) != a_existing_sym_tab.end() && 
-        a_existing_sym_tab[sym_name].m_type != sym.m_type
-    ) {
-      std::cerr << "Greska: Vise puta se koristi simbol " << sym_name << " sa razlicitm tipom" << std::endl;
-      return true;
+/// Interns the names of the input symbols once, the merge below works on ids.
+std::vector<InputSym> internInputSymbols(SymbolTable& a_input_sym_tab) {
+  std::vector<InputSym> input_syms;
+  input_syms.reserve(a_input_sym_tab.size());
+  for (auto& [sym_name, sym] : a_input_sym_tab) {
+    NameId sctn = sectionId(sym.m_type == SymbolType::SCTN ? sym_name : sym.m_sctn_name);
+    input_syms.push_back(InputSym{&sym, symbolId(sym_name), sctn});
+  }
+  return input_syms;
+}
+
+bool hasConflictingSymbolDefinitions(const std::vector<InputSym>& a_input_syms) {
+  for (const auto& input_sym : a_input_syms) {
+    const Sym& sym = *input_sym.m_sym;
+    const LinkerSym& existing = linker_syms[input_sym.m_id];
+    if (!existing.m_present) {
+      continue;
     }
-    if (a_existing_sym_tab.find(sym_name) != a_existing_sym_tab.end() && 
-        a_existing_sym_tab[sym_name].m_bind != sym.m_bind
-    ) {
-      std::cerr << "Greska: Vise puta se koristi simbol " << sym_name << " sa razlicitm vezivanjem" << std::endl;
+    if (existing.m_sym.m_type != sym.m_type) {
+      std::cerr << "Greska: Vise puta se koristi simbol " << sym.m_name << " sa razlicitm tipom" << std::endl;
       return true;
     }
-    if (sym.m_defined && 
-        a_existing_sym_tab.find(sym_name) != a_existing_sym_tab.end() && 
-        a_existing_sym_tab[sym_name].m_defined &&
-        sym.m_type != SymbolType::SCTN) {
-      std::cerr << "Greska: Visestruka definicija simbola " << sym_name << std::endl;
+    if (existing.m_sym.m_bind != sym.m_bind) {
+      std::cerr << "Greska: Vise puta se koristi simbol " << sym.m_name << " sa razlicitm vezivanjem" << std::endl;
       return true;
     }
-  }
-  return false;
-}
-
-bool hasOverlappingSection(
-  const std::string& a_input_section,
-  std::vector<std::string>& a_existing_sections
-) {
-  for (const auto& existing_section : a_existing_sections) {
-    if (a_input_section == existing_section) {
+    if (sym.m_defined && existing.m_sym.m_defined && sym.m_type != SymbolType::SCTN) {
+      std::cerr << "Greska: Visestruka definicija simbola " << sym.m_name << std::endl;
       return true;
     }
   }
@@ -171,123 +347,239 @@ bool hasOverlappingSection(
 }
 
 void handleSectionsOverlapping(
-  const std::string& a_input_section,
-  SymbolTable& a_input_sym_tab,
-  SectionRelasTable& a_input_section_relas_table
+  NameId a_input_section,
+  std::vector<InputSym>& a_input_syms,
+  std::vector<Rela>* a_input_relas
 ) {
-  uint32_t existing_sctn_sz = linker_section_data_table[a_input_section].size();
+  uint32_t existing_sctn_sz = linker_section_table[a_input_section].m_size;
   
   /// update value of the symbols defined in the overlapping section
-  for (auto& [sym_name, sym] : a_input_sym_tab) {
-    if (sym.m_sctn_name == a_input_section && sym.m_type != SymbolType::SCTN) {
-      sym.m_value+= existing_sctn_sz;
+  for (auto& input_sym : a_input_syms) {
+    if (input_sym.m_sctn == a_input_section && input_sym.m_sym->m_type != SymbolType::SCTN) {
+      input_sym.m_sym->m_value+= existing_sctn_sz;
     }
   }
 
   /// update offset of the overlapping section relocations
-  for (auto& rela : a_input_section_relas_table[a_input_section]) {
-    rela.m_offset+= existing_sctn_sz;
+  if (a_input_relas != nullptr) {
+    for (auto& rela : *a_input_relas) {
+      rela.m_offset+= existing_sctn_sz;
+    }
   }
 }
 
-void mergeSymbolTables(
-  SymbolTable& a_input_sym_tab,
-  SymbolTable& a_existing_sym_tab
-) {
-  for (const auto& [sym_name, sym] : a_input_sym_tab) {
+void mergeSymbolTables(const std::vector<InputSym>& a_input_syms) {
+  for (const auto& input_sym : a_input_syms) {
+    const Sym& sym = *input_sym.m_sym;
     if (sym.m_bind == SymbolBinding::LOC &&  sym.m_type != SymbolType::SCTN) {
       continue;
     }
-    if (a_existing_sym_tab.find(sym_name) != a_existing_sym_tab.end() &&
-        a_existing_sym_tab[sym_name].m_type == SymbolType::SCTN
-    ) {
+    LinkerSym& existing = linker_syms[input_sym.m_id];
+    if (existing.m_present && existing.m_sym.m_type == SymbolType::SCTN) {
       continue;
     }
-    if (a_existing_sym_tab.find(sym_name) == a_existing_sym_tab.end() || 
-        (!a_existing_sym_tab[sym_name].m_defined && sym.m_defined)
-    ) {
-        a_existing_sym_tab[sym_name] = sym;
+    if (!existing.m_present || (!existing.m_sym.m_defined && sym.m_defined)) {
+      existing.m_sym = sym;
+      existing.m_sctn = input_sym.m_sctn;
+      existing.m_present = true;
     }
   }
 }
 
-void mergeRelocations(
-  SectionRelasTable& a_input_section_relas_table, 
-  SectionRelasTable& a_existing_section_relas_table
-) {
+void mergeRelocations(SectionRelasTable& a_input_section_relas_table) {
   for (const auto& [section, relocations] : a_input_section_relas_table) {
+    NameId sctn = sectionId(section);
     for (const auto& rela : relocations) {
-      a_existing_section_relas_table[section].push_back(rela);
+      NameId sym = symbolId(rela.m_sym_name);
+      linker_section_table[sctn].m_relas.push_back(LinkerRela{rela.m_offset, sym, rela.m_addend});
     }
   }
 }
 
-void mergeSectionContents(
-  SectionDataTable& a_input_section_data_table, 
-  SectionDataTable& a_existing_section_data_table
-) {
-  for (const auto& [section, data] : a_input_section_data_table) {
-    for (const auto& byte : data) {
-      a_existing_section_data_table[section].push_back(byte);
+void mergeSectionContents(SectionViewTable& a_input_section_views) {
+  for (const auto& [section, view] : a_input_section_views) {
+    LinkerSection& sctn = linker_section_table[sectionId(section)];
+    sctn.m_pieces.push_back(view);
+    sctn.m_size+= view.m_size;
+  }
+}
+
+/// Copies the input pieces of every section into its output buffer, this is
+/// the only copy of section contents, done once the layout is known and
+/// relocations are about to be patched in.
+void materializeSections() {
+  for (NameId section : linker_sections) {
+    LinkerSection& sctn = linker_section_table[section];
+    sctn.m_data.reserve(sctn.m_size);
+    for (const auto& piece : sctn.m_pieces) {
+      sctn.m_data.insert(sctn.m_data.end(), piece.m_data, piece.m_data + piece.m_size);
     }
   }
 }
 
-int8_t handleInputFile(const std::string& a_input_file) {
-  SymbolTable input_sym_tab;
-  SectionRelasTable input_section_relas_table;
-  SectionDataTable input_section_data_table;
-  std::vector<std::string> input_sections;
-  if (parseLinkerInput(
-        a_input_file,
-        input_sym_tab,
-        input_section_relas_table,
-        input_section_data_table,
-        input_sections) == 1) {
-          return 1;
+void parseInputFiles(const std::vector<std::string>& a_input_files, std::size_t a_jobs) {
+  for (const auto& input_file : a_input_files) {
+    linker_inputs.push_back(std::make_unique<LinkerInput>());
+    linker_inputs.back()->m_file_name = input_file;
   }
-  
-  if (hasConflictingSymbolDefinitions(input_sym_tab, linker_sym_tab)) {
+  runWorkStealing(linker_inputs.size(), a_jobs, [] (std::size_t a_ndx) {
+    parseLinkerInput(*linker_inputs[a_ndx]);
+  });
+}
+
+int8_t handleInputFile(LinkerInput& a_input) {
+  if (!a_input.m_error.empty()) {
+    std::cerr << a_input.m_error << "\n";
+    return 1;
+  }
+  if (a_input.m_is_archive) {
+    return 0;
+  }
+
+  std::vector<InputSym> input_syms = internInputSymbols(a_input.m_sym_tab);
+  if (hasConflictingSymbolDefinitions(input_syms)) {
     return 1;
   }
 
-  for (const auto& input_section : input_sections) {
-    bool is_overlapping_section = hasOverlappingSection(input_section, linker_sections);
-    if (is_overlapping_section) {
-      handleSectionsOverlapping(input_section, input_sym_tab, input_section_relas_table);
+  for (const auto& input_section : a_input.m_sections) {
+    NameId sctn = sectionId(input_section);
+    if (linker_section_table[sctn].m_present) {
+      auto relas_it = a_input.m_section_relas_table.find(input_section);
+      handleSectionsOverlapping(
+        sctn,
+        input_syms,
+        relas_it != a_input.m_section_relas_table.end() ? &relas_it->second : nullptr
+      );
     } else {
-      linker_sections.push_back(input_section);
+      linker_section_table[sctn].m_present = true;
+      linker_sections.push_back(sctn);
     }
   }
 
+  mergeSymbolTables(input_syms);
+  mergeRelocations(a_input.m_section_relas_table);
+  mergeSectionContents(a_input.m_section_views);
 
+  return 0;
+}
 
-  mergeSymbolTables(input_sym_tab, linker_sym_tab);
-  mergeRelocations(input_section_relas_table, linker_section_relas_table);
-  mergeSectionContents(input_section_data_table, linker_section_data_table);
+/// Pulls in the archive members that define a symbol which is still
+/// undefined, in rounds until a round adds nothing. Archives are searched in
+/// command line order once all object files are merged. The members of a
+/// round are parsed in parallel and merged in the order of the symbols that
+/// needed them, each member at most once.
+int8_t extractArchiveMembers(std::size_t a_jobs) {
+  std::vector<LinkerInput*> archives;
+  for (const auto& input : linker_inputs) {
+    if (input->m_is_archive) {
+      archives.push_back(input.get());
+    }
+  }
+
+  while (!archives.empty()) {
+    std::vector<std::unique_ptr<LinkerInput>> members;
+    std::vector<const ArchiveMember*> member_data;
+    for (const auto& linker_sym : linker_syms) {
+      if (!linker_sym.m_present || linker_sym.m_sym.m_defined) {
+        continue;
+      }
+      for (LinkerInput* archive : archives) {
+        auto it = archive->m_archive.m_symbols.find(linker_sym.m_sym.m_name);
+        if (it == archive->m_archive.m_symbols.end()) {
+          continue;
+        }
+        if (!archive->m_extracted[it->second]) {
+          archive->m_extracted[it->second] = true;
+          const ArchiveMember& member = archive->m_archive.m_members[it->second];
+          members.push_back(std::make_unique<LinkerInput>());
+          members.back()->m_file_name = archive->m_file_name + "(" + member.m_name + ")";
+          member_data.push_back(&member);
+        }
+        break;
+      }
+    }
+    if (members.empty()) {
+      break;
+    }
+
+    runWorkStealing(members.size(), a_jobs, [&] (std::size_t a_ndx) {
+      parseInputData(*members[a_ndx], member_data[a_ndx]->m_data, member_data[a_ndx]->m_size);
+    });
+    for (auto& member : members) {
+      if (handleInputFile(*member) == 1) {
+        return 1;
+      }
+      linker_inputs.push_back(std::move(member));
+    }
+  }
+  return 0;
+}
+
+/// Bundles the inputs into an archive, indexing the global symbols each of
+/// them defines.
+int8_t writeArchive(std::ostream& a_out) {
+  std::vector<ArchiveMember> members;
+  std::vector<std::pair<std::string, uint32_t>> symbols;
+  std::unordered_map<std::string, uint32_t> defining_member;
+  for (const auto& input : linker_inputs) {
+    if (!input->m_error.empty()) {
+      std::cerr << input->m_error << "\n";
+      return 1;
+    }
+    if (input->m_is_archive) {
+      std::cerr << "Greska: Arhiva " << input->m_file_name << " ne moze biti clan arhive\n";
+      return 1;
+    }
+    uint32_t member_ndx = static_cast<uint32_t>(members.size());
+    const std::string& file_name = input->m_file_name;
+    members.emplace_back(
+      file_name.substr(file_name.find_last_of('/') + 1),
+      input->m_file.m_data,
+      static_cast<uint32_t>(input->m_file.m_size)
+    );
+
+    std::size_t first_symbol = symbols.size();
+    for (const auto& [sym_name, sym] : input->m_sym_tab) {
+      if (sym.m_bind != SymbolBinding::GLOB || !sym.m_defined || sym.m_type == SymbolType::SCTN) {
+        continue;
+      }
+      if (!defining_member.emplace(sym_name, member_ndx).second) {
+        std::cerr << "Greska: Visestruka definicija simbola " << sym_name << " u arhivi\n";
+        return 1;
+      }
+      symbols.emplace_back(sym_name, member_ndx);
+    }
+    std::sort(symbols.begin() + first_symbol, symbols.end());
+  }
 
+  writeArchiveFile(a_out, members, symbols);
   return 0;
 }
 
-bool hasUndefinedSymbols(SymbolTable& a_sym_tab) {
-  for (const auto& [sym_name, sym] : a_sym_tab) {
-    if (!sym.m_defined) {
-      std::cerr << "Greska: Ne postoji definicija simbola " << sym_name << std::endl;
+bool hasUndefinedSymbols() {
+  for (const auto& linker_sym : linker_syms) {
+    if (linker_sym.m_present && !linker_sym.m_sym.m_defined) {
+      std::cerr << "Greska: Ne postoji definicija simbola " << linker_sym.m_sym.m_name << std::endl;
       return true;
     }
   }
   return false;
 }
 
-void handleArguments(
+int32_t handleArguments(
   int a_argc,
   char* a_argv[],
   std::vector<std::string>& a_input_files,
   std::string& a_output_file,
+  std::string& a_symtab_file,
   bool& a_hex_mode,
-  bool& a_reloc_mode
+  bool& a_bin_mode,
+  bool& a_reloc_mode,
+  bool& a_text_mode,
+  bool& a_archive_mode,
+  std::size_t& a_jobs
 ) {
-  for(uint8_t i = 1; i < a_argc; i++) {
+  for(int i = 1; i < a_argc; i++) {
     std::string arg = std::string(a_argv[i]);
     if (arg == "-o") {
       a_output_file = std::string(a_argv[i+1]);
@@ -299,16 +591,28 @@ void handleArguments(
       uint32_t addr = 
         static_cast<uint32_t>(std::stoul(arg.substr(delimeter_pos + 1), nullptr, 0));
       linker_section_place_table.push_back(SectionPlace(scnt_name, addr));
+    } else if (arg.find("-symtab=") == 0) {
+      a_symtab_file = arg.substr(SYMTAB_FILE_NDX);
     } else if (arg == "-hex") {
       a_hex_mode = true;
+    } else if (arg == "-bin") {
+      a_bin_mode = true;
     } else if (arg == "-relocatable") {
       a_reloc_mode = true;
+    } else if (arg == "-archive") {
+      a_archive_mode = true;
+    } else if (arg == "--text") {
+      a_text_mode = true;
+    } else if (arg.find("--jobs=") == 0) {
+      if (!parseOptionNumber(arg.substr(JOBS_ARG_OFF), a_jobs)) {
+        std::cerr << "Greska: Neispravna vrednost opcije: " << arg << std::endl;
+        return 1;
+      }
     } else {
       a_input_files.push_back(arg);
     }
   }
-
-  
+  return 0;
 }
 
 uint32_t alignedAddr(uint32_t a_addr) {
@@ -317,50 +621,92 @@ uint32_t alignedAddr(uint32_t a_addr) {
 
 void linkSectionToAddr() {
   uint32_t location_counter = 0x00000000;
-  std::unordered_set<std::string> placed_sections;
-
+  std::vector<NameId> placed_ids;
   for (const auto& section_place_entry : linker_section_place_table) {
-    linker_sym_tab[section_place_entry.m_sctn_name].m_value = section_place_entry.m_addr;
-    placed_sections.insert(section_place_entry.m_sctn_name);
-    location_counter =
-       section_place_entry.m_addr + linker_section_data_table[section_place_entry.m_sctn_name].size();
-    location_counter = alignedAddr(location_counter);
+    placed_ids.push_back(sectionId(section_place_entry.m_sctn_name));
+  }
+  std::vector<bool> placed_sections(linker_section_table.size(), false);
+
+  for (std::size_t i = 0; i < placed_ids.size(); i++) {
+    LinkerSection& sctn = linker_section_table[placed_ids[i]];
+    sctn.m_addr = linker_section_place_table[i].m_addr;
+    placed_sections[placed_ids[i]] = true;
+    location_counter = alignedAddr(sctn.m_addr + sctn.m_size);
   }
 
-  for (const auto& section : linker_sections) {
-    if (placed_sections.find(section) == placed_sections.end()) {
-      linker_sym_tab[section].m_value = location_counter;
-      location_counter+= linker_section_data_table[section].size();
+  for (NameId section : linker_sections) {
+    if (!placed_sections[section]) {
+      LinkerSection& sctn = linker_section_table[section];
+      sctn.m_addr = location_counter;
+      location_counter+= sctn.m_size;
       location_counter = alignedAddr(location_counter);
-      placed_sections.insert(section);
+      placed_sections[section] = true;
     }
   }
 
   std::sort(
     linker_sections.begin(), 
     linker_sections.end(),
-    [] (const auto& a_higher, const auto& a_lower) {
-      return linker_sym_tab[a_higher].m_value < linker_sym_tab[a_lower].m_value;
+    [] (NameId a_higher, NameId a_lower) {
+      return linker_section_table[a_higher].m_addr < linker_section_table[a_lower].m_addr;
     }
   );
 }
 
 void updateSymTab() {
-  for (auto& [sym_name, sym] : linker_sym_tab) {
-    if (sym.m_type != SymbolType::SCTN && sym.m_sctn_name != "#EQU") {
-      sym.m_value+= linker_sym_tab[sym.m_sctn_name].m_value;
+  NameId equ_sctn = sectionId("#EQU");
+  for (auto& linker_sym : linker_syms) {
+    if (!linker_sym.m_present) {
+      continue;
+    }
+    Sym& sym = linker_sym.m_sym;
+    if (sym.m_type == SymbolType::SCTN) {
+      sym.m_value = linker_section_table[linker_sym.m_sctn].m_addr;
+    } else if (linker_sym.m_sctn != equ_sctn) {
+      sym.m_value+= linker_section_table[linker_sym.m_sctn].m_addr;
     }
   }
 }
 
 void applyRelocations() { 
-  for (const auto& section : linker_sections) {
-    for (const auto& rela : linker_section_relas_table[section]) {
-      updateWord(
-        linker_section_data_table, 
-        section, 
-        rela.m_offset, 
-        linker_sym_tab[rela.m_sym_name].m_value + rela.m_addend
+  for (NameId section : linker_sections) {
+    LinkerSection& sctn = linker_section_table[section];
+    for (const auto& rela : sctn.m_relas) {
+      writeLe32(sctn.m_data.data() + rela.m_offset, linker_syms[rela.m_sym].m_sym.m_value + rela.m_addend);
+    }
+  }
+}
+
+/// The shared writers take string keyed tables, they are built once the
+/// link is done.
+SymbolTable exportSymbolTable() {
+  SymbolTable sym_tab;
+  for (const auto& linker_sym : linker_syms) {
+    if (linker_sym.m_present) {
+      sym_tab.emplace(linker_sym.m_sym.m_name, linker_sym.m_sym);
+    }
+  }
+  return sym_tab;
+}
+
+void exportSections(
+  std::vector<std::string>& a_sections,
+  SectionDataTable& a_section_data_table,
+  SectionRelasTable& a_section_relas_table
+) {
+  for (NameId section : linker_sections) {
+    const std::string& sctn_name = linker_sctn_names.name(section);
+    LinkerSection& sctn = linker_section_table[section];
+    a_sections.push_back(sctn_name);
+    a_section_data_table[sctn_name] = std::move(sctn.m_data);
+    if (sctn.m_relas.empty()) {
+      continue;
+    }
+    auto& relas = a_section_relas_table[sctn_name];
+    relas.reserve(sctn.m_relas.size());
+    for (const auto& rela : sctn.m_relas) {
+      relas.emplace_back(
+        rela.m_offset, linker_sym_names.name(rela.m_sym), RelocationType::R_X86_64_32, rela.m_addend
       );
     }
   }
@@ -369,27 +715,47 @@ void applyRelocations() {
 int main(int argc, char* argv[]) {
   std::vector<std::string> input_files;
   std::string output_file = "build/program.hex";
+  std::string symtab_file;
   bool hex_mode = false;
+  bool bin_mode = false;
   bool reloc_mode = false;
-  handleArguments(argc, argv, input_files, output_file, hex_mode, reloc_mode);
-  std::ofstream out(output_file);
+  bool text_mode = false;
+  bool archive_mode = false;
+  std::size_t jobs = 0;
+  int32_t status = handleArguments(
+    argc, argv, input_files, output_file, symtab_file, 
+    hex_mode, bin_mode, reloc_mode, text_mode, archive_mode, jobs
+  );
+  if (status != 0) {
+    return status;
+  }
+  bool binary_out = bin_mode || archive_mode || (reloc_mode && !text_mode);
+  std::ofstream out(output_file, binary_out ? std::ios::binary : std::ios::out);
 
-  if(!hex_mode && !reloc_mode) {
+  if(!hex_mode && !bin_mode && !reloc_mode && !archive_mode) {
     std::cerr << "Greska: Nije prosledjena opcija u kom modu linker treba da radi" << std::endl;
     return 1;
-  } else if (hex_mode && reloc_mode) {
+  } else if (hex_mode + bin_mode + reloc_mode + archive_mode > 1) {
     std::cerr << "Greska: Nije moguce odrediti u kom modu linker treba da radi" << std::endl;
     return 1;
   }
 
-  for(const auto& input_file : input_files) {
-    if (handleInputFile(input_file) == 1) {
+  parseInputFiles(input_files, jobs);
+  if (archive_mode) {
+    return writeArchive(out);
+  }
+
+  for(const auto& input : linker_inputs) {
+    if (handleInputFile(*input) == 1) {
       return 1;
     }
   }
+  if (extractArchiveMembers(jobs) == 1) {
+    return 1;
+  }
 
-  if (hex_mode) {
-    if (hasUndefinedSymbols(linker_sym_tab)) {
+  if (hex_mode || bin_mode) {
+    if (hasUndefinedSymbols()) {
       return 1;
     }
 
@@ -399,12 +765,34 @@ int main(int argc, char* argv[]) {
 
     linkSectionToAddr();
     updateSymTab();
+    materializeSections();
     applyRelocations();
+  } else {
+    materializeSections();
+  }
+
+  SymbolTable sym_tab = exportSymbolTable();
+  std::vector<std::string> sections;
+  SectionDataTable section_data_table;
+  SectionRelasTable section_relas_table;
+  exportSections(sections, section_data_table, section_relas_table);
 
-    writeSections(out, linker_section_data_table, linker_sections, linker_sym_tab, hex_mode);
+  if (hex_mode || bin_mode) {
+    if (bin_mode) {
+      writeImage(out, section_data_table, sections, sym_tab);
+    } else {
+      writeSections(out, section_data_table, sections, sym_tab, hex_mode);
+    }
+
+    if (!symtab_file.empty()) {
+      std::ofstream symtab_out(symtab_file);
+      writeSymTab(symtab_out, sym_tab);
+    }
+  } else if(reloc_mode && !text_mode) {
+    writeObjectFile(out, sym_tab, section_relas_table, section_data_table, sections);
   } else if(reloc_mode) {
-    writeSymTab(out, linker_sym_tab);
-    writeRela(out, linker_section_relas_table, linker_sections);
-    writeSections(out, linker_section_data_table, linker_sections, linker_sym_tab, hex_mode);
+    writeSymTab(out, sym_tab);
+    writeRela(out, section_relas_table, sections);
+    writeSections(out, section_data_table, sections, sym_tab, hex_mode);
   }
 }
@@ -0,0 +1,35 @@
+#include "../inc/mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+  if (m_data != nullptr) {
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+  }
+}
+
+bool mapFile(const std::string& a_input_file, MappedFile& a_file) {
+  int fd = open(a_input_file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+  a_file.m_size = static_cast<std::size_t>(st.st_size);
+  if (a_file.m_size > 0) {
+    void* data = mmap(nullptr, a_file.m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    a_file.m_data = static_cast<const uint8_t*>(data);
+  }
+  close(fd);
+  return true;
+}
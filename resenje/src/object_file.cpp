@@ -0,0 +1,201 @@
+#include "../inc/object_file.hpp"
+#include "../inc/common.hpp"
+#include "../inc/image.hpp"
+#include <cstring>
+
+/// Names are stored once, symbols and relocations refer to them by offset.
+struct StringTable {
+  std::vector<char> m_data;
+  std::unordered_map<std::string, uint32_t> m_offsets;
+
+  uint32_t add(const std::string& a_str) {
+    auto it = m_offsets.find(a_str);
+    if (it != m_offsets.end()) {
+      return it->second;
+    }
+    uint32_t off = static_cast<uint32_t>(m_data.size());
+    m_data.insert(m_data.end(), a_str.begin(), a_str.end());
+    m_data.push_back('\0');
+    m_offsets.emplace(a_str, off);
+    return off;
+  }
+};
+
+void appendLe32(std::vector<uint8_t>& a_buf, uint32_t a_val) {
+  std::size_t pos = a_buf.size();
+  a_buf.resize(pos + 4);
+  writeLe32(a_buf.data() + pos, a_val);
+}
+
+void writeObjectFile(
+  std::ostream& a_out,
+  SymbolTable& a_sym_tab,
+  SectionRelasTable& a_section_relas_table,
+  SectionDataTable& a_section_data_table,
+  std::vector<std::string>& a_sections
+) {
+  StringTable strtab;
+  SymbolList syms = sortSymbols(a_sym_tab);
+
+  std::vector<uint8_t> sym_buf;
+  sym_buf.reserve(syms.size() * OBJECT_SYMBOL_SIZE);
+  for (const auto& sym : syms) {
+    appendLe32(sym_buf, strtab.add(sym.m_name));
+    appendLe32(sym_buf, strtab.add(sym.m_sctn_name));
+    appendLe32(sym_buf, sym.m_value);
+    appendLe32(sym_buf, sym.m_index);
+    sym_buf.push_back(static_cast<uint8_t>(sym.m_type));
+    sym_buf.push_back(static_cast<uint8_t>(sym.m_bind));
+    sym_buf.push_back(sym.m_defined ? 1 : 0);
+    sym_buf.push_back(0);
+  }
+
+  std::vector<uint8_t> sctn_buf;
+  std::vector<uint8_t> rela_buf;
+  sctn_buf.reserve(a_sections.size() * OBJECT_SECTION_SIZE);
+  for (const auto& section : a_sections) {
+    auto relas_it = a_section_relas_table.find(section);
+    uint32_t rela_cnt = 0;
+    if (relas_it != a_section_relas_table.end()) {
+      sortRelas(relas_it->second);
+      rela_cnt = static_cast<uint32_t>(relas_it->second.size());
+      for (const auto& rela : relas_it->second) {
+        appendLe32(rela_buf, rela.m_offset);
+        appendLe32(rela_buf, strtab.add(rela.m_sym_name));
+        appendLe32(rela_buf, static_cast<uint32_t>(rela.m_rela_type));
+        appendLe32(rela_buf, static_cast<uint32_t>(rela.m_addend));
+      }
+    }
+    appendLe32(sctn_buf, strtab.add(section));
+    appendLe32(sctn_buf, static_cast<uint32_t>(a_section_data_table[section].size()));
+    appendLe32(sctn_buf, rela_cnt);
+  }
+
+  uint8_t header[OBJECT_HEADER_SIZE];
+  std::memcpy(header, OBJECT_MAGIC, sizeof(OBJECT_MAGIC));
+  writeLe32(header + 4, OBJECT_VERSION);
+  writeLe32(header + 8, static_cast<uint32_t>(strtab.m_data.size()));
+  writeLe32(header + 12, static_cast<uint32_t>(syms.size()));
+  writeLe32(header + 16, static_cast<uint32_t>(a_sections.size()));
+
+  a_out.write(reinterpret_cast<const char*>(header), OBJECT_HEADER_SIZE);
+  a_out.write(strtab.m_data.data(), strtab.m_data.size());
+  a_out.write(reinterpret_cast<const char*>(sym_buf.data()), sym_buf.size());
+  a_out.write(reinterpret_cast<const char*>(sctn_buf.data()), sctn_buf.size());
+  a_out.write(reinterpret_cast<const char*>(rela_buf.data()), rela_buf.size());
+  for (const auto& section : a_sections) {
+    const auto& data = a_section_data_table[section];
+    a_out.write(reinterpret_cast<const char*>(data.data()), data.size());
+  }
+}
+
+bool isObjectData(const uint8_t* a_data, std::size_t a_size) {
+  return a_size >= sizeof(OBJECT_MAGIC) &&
+    std::memcmp(a_data, OBJECT_MAGIC, sizeof(OBJECT_MAGIC)) == 0;
+}
+
+/// Checks every count and offset against a_size before touching the data and
+/// every relocation against its section size, a truncated or corrupt object
+/// is rejected instead of read or patched out of bounds.
+bool parseObjectFile(
+  const uint8_t* a_data,
+  std::size_t a_size,
+  SymbolTable& a_sym_tab,
+  SectionRelasTable& a_section_relas_table,
+  SectionViewTable& a_section_views,
+  std::vector<std::string>& a_sections
+) {
+  if (a_size < OBJECT_HEADER_SIZE || !isObjectData(a_data, a_size) ||
+      readLe32(a_data + 4) != OBJECT_VERSION) {
+    return false;
+  }
+  uint64_t strtab_size = readLe32(a_data + 8);
+  uint64_t sym_cnt = readLe32(a_data + 12);
+  uint64_t sctn_cnt = readLe32(a_data + 16);
+
+  uint64_t strtab_off = OBJECT_HEADER_SIZE;
+  uint64_t sym_off = strtab_off + strtab_size;
+  uint64_t sctn_off = sym_off + sym_cnt * OBJECT_SYMBOL_SIZE;
+  uint64_t rela_off = sctn_off + sctn_cnt * OBJECT_SECTION_SIZE;
+  if (rela_off > a_size || (strtab_size > 0 && a_data[sym_off - 1] != '\0')) {
+    return false;
+  }
+
+  const char* strtab = reinterpret_cast<const char*>(a_data + strtab_off);
+  auto name = [&] (uint32_t a_off, std::string& a_name) {
+    if (a_off >= strtab_size) {
+      return false;
+    }
+    a_name.assign(strtab + a_off);
+    return true;
+  };
+
+  uint64_t rela_cnt = 0;
+  uint64_t data_size = 0;
+  for (uint64_t i = 0; i < sctn_cnt; i++) {
+    const uint8_t* entry = a_data + sctn_off + i * OBJECT_SECTION_SIZE;
+    data_size += readLe32(entry + 4);
+    rela_cnt += readLe32(entry + 8);
+  }
+  uint64_t data_off = rela_off + rela_cnt * OBJECT_RELA_SIZE;
+  if (data_off + data_size > a_size) {
+    return false;
+  }
+
+  for (uint64_t i = 0; i < sym_cnt; i++) {
+    const uint8_t* entry = a_data + sym_off + i * OBJECT_SYMBOL_SIZE;
+    uint8_t type = entry[16];
+    uint8_t bind = entry[17];
+    Sym sym;
+    if (!name(readLe32(entry), sym.m_name) || !name(readLe32(entry + 4), sym.m_sctn_name) ||
+        type > SymbolType::OBJ || bind > SymbolBinding::GLOB) {
+      return false;
+    }
+    sym.m_value = readLe32(entry + 8);
+    sym.m_index = readLe32(entry + 12);
+    sym.m_type = static_cast<SymbolType>(type);
+    sym.m_bind = static_cast<SymbolBinding>(bind);
+    sym.m_defined = entry[18] != 0;
+    std::string sym_name = sym.m_name;
+    a_sym_tab[sym_name] = std::move(sym);
+  }
+
+  const uint8_t* rela_entry = a_data + rela_off;
+  const uint8_t* sctn_data = a_data + data_off;
+  a_sections.reserve(sctn_cnt);
+  for (uint64_t i = 0; i < sctn_cnt; i++) {
+    const uint8_t* entry = a_data + sctn_off + i * OBJECT_SECTION_SIZE;
+    std::string sctn_name;
+    if (!name(readLe32(entry), sctn_name)) {
+      return false;
+    }
+    uint32_t size = readLe32(entry + 4);
+    uint32_t sctn_rela_cnt = readLe32(entry + 8);
+
+    if (sctn_rela_cnt > 0) {
+      auto& relas = a_section_relas_table[sctn_name];
+      relas.reserve(relas.size() + sctn_rela_cnt);
+      for (uint32_t j = 0; j < sctn_rela_cnt; j++, rela_entry += OBJECT_RELA_SIZE) {
+        std::string sym_name;
+        if (!name(readLe32(rela_entry + 4), sym_name) ||
+            readLe32(rela_entry + 8) != RelocationType::R_X86_64_32 ||
+            static_cast<uint64_t>(readLe32(rela_entry)) + 4 > size) {
+          return false;
+        }
+        relas.emplace_back(
+          readLe32(rela_entry),
+          std::move(sym_name),
+          RelocationType::R_X86_64_32,
+          static_cast<int32_t>(readLe32(rela_entry + 12))
+        );
+      }
+    }
+
+    if (size > 0) {
+      a_section_views[sctn_name] = SectionView(sctn_data, size);
+      sctn_data += size;
+    }
+    a_sections.push_back(std::move(sctn_name));
+  }
+  return true;
+}
@@ -0,0 +1,78 @@
+#include "../inc/work_pool.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+bool takeTask(WorkQueue& a_queue, std::size_t& a_task) {
+  std::lock_guard<std::mutex> guard(a_queue.m_lock);
+  if (a_queue.m_tasks.empty()) {
+    return false;
+  }
+  a_task = a_queue.m_tasks.front();
+  a_queue.m_tasks.pop_front();
+  return true;
+}
+
+bool stealTask(WorkQueue& a_queue, std::size_t& a_task) {
+  std::lock_guard<std::mutex> guard(a_queue.m_lock);
+  if (a_queue.m_tasks.empty()) {
+    return false;
+  }
+  a_task = a_queue.m_tasks.back();
+  a_queue.m_tasks.pop_back();
+  return true;
+}
+
+void runWorker(
+  std::vector<std::unique_ptr<WorkQueue>>& a_queues, 
+  std::size_t a_self, 
+  const std::function<void(std::size_t)>& a_task
+) {
+  std::size_t task;
+  while (true) {
+    if (takeTask(*a_queues[a_self], task)) {
+      a_task(task);
+      continue;
+    }
+    // no task is added after the start, so one empty sweep means done
+    bool stolen = false;
+    for (std::size_t i = 1; i < a_queues.size() && !stolen; i++) {
+      stolen = stealTask(*a_queues[(a_self + i) % a_queues.size()], task);
+    }
+    if (!stolen) {
+      return;
+    }
+    a_task(task);
+  }
+}
+
+void runWorkStealing(
+  std::size_t a_task_cnt, 
+  std::size_t a_thread_cnt, 
+  const std::function<void(std::size_t)>& a_task
+) {
+  if (a_thread_cnt == 0) {
+    a_thread_cnt = std::max(1u, std::thread::hardware_concurrency());
+  }
+  a_thread_cnt = std::max<std::size_t>(1, std::min(a_thread_cnt, a_task_cnt));
+
+  // contiguous slices keep neighbouring tasks on one worker until it runs dry
+  std::vector<std::unique_ptr<WorkQueue>> queues;
+  for (std::size_t i = 0; i < a_thread_cnt; i++) {
+    queues.push_back(std::make_unique<WorkQueue>());
+  }
+  for (std::size_t task = 0; task < a_task_cnt; task++) {
+    queues[task * a_thread_cnt / a_task_cnt]->m_tasks.push_back(task);
+  }
+
+  std::vector<std::thread> workers;
+  for (std::size_t i = 1; i < a_thread_cnt; i++) {
+    workers.emplace_back(runWorker, std::ref(queues), i, std::cref(a_task));
+  }
+  runWorker(queues, 0, a_task);
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
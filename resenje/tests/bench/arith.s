@@ -0,0 +1,24 @@
+# file: arith.s
+# Register only arithmetic, logic and shift loop.
+
+.global bench_start
+
+.section bench
+bench_start:
+    ld $0xFFFFFEFE, %sp
+    ld $10000000, %r1
+    ld $1, %r2
+    ld $3, %r3
+    ld $0, %r4
+    ld $0x12345, %r5
+loop:
+    add %r3, %r4
+    mul %r3, %r5
+    xor %r4, %r5
+    shr %r2, %r5
+    or %r2, %r4
+    sub %r2, %r1
+    bne %r1, %r0, loop
+    halt
+
+.end
@@ -0,0 +1,44 @@
+# Assembles and links every benchmark in this directory, runs each one
+# headless on every emulator engine and reports MIPS, wall time and peak
+# RSS. Each result is also appended to $RESULTS as one JSON object per
+# line, tagged with the git revision, for tracking over time.
+BENCH_DIR=$(dirname "$0")
+BUILD_DIR=${BUILD_DIR:-build}
+ASSEMBLER=${ASSEMBLER:-$BUILD_DIR/asembler}
+LINKER=${LINKER:-$BUILD_DIR/linker}
+EMULATORS=${EMULATORS:-"$BUILD_DIR/emulator $BUILD_DIR/emulator-threaded $BUILD_DIR/emulator-block"}
+OUT_DIR=${OUT_DIR:-$BUILD_DIR/bench}
+RESULTS=${RESULTS:-$OUT_DIR/results.jsonl}
+# instructions per virtual millisecond, keeps timer interrupts reproducible
+VTIME=10
+
+REV=$(git -C "$BENCH_DIR" rev-parse --short HEAD 2>/dev/null || echo unknown)
+STAMP=$(date -u +%Y-%m-%dT%H:%M:%SZ)
+mkdir -p "$OUT_DIR"
+
+printf '%-12s %-9s %12s %9s %9s %9s\n' bench engine instrs mips wall_s rss_kib
+for src in "$BENCH_DIR"/*.s; do
+  name=$(basename "$src" .s)
+  ${ASSEMBLER} -o "$OUT_DIR/$name.o" "$src" || exit 1
+  ${LINKER} -hex -place=bench@0x40000000 -o "$OUT_DIR/$name.hex" "$OUT_DIR/$name.o" || exit 1
+  for emu in ${EMULATORS}; do
+    report="$OUT_DIR/$name.$(basename "$emu").txt"
+    start=$(date +%s%N)
+    ${emu} "$OUT_DIR/$name.hex" --headless --output=/dev/null -vtime=$VTIME -bench > /dev/null 2> "$report" || exit 1
+    end=$(date +%s%N)
+    awk -v bench="$name" -v wall_ns=$((end - start)) -v rev="$REV" -v stamp="$STAMP" -v results="$RESULTS" '
+      /^Dispatch engine:/ { engine = $3 }
+      /^Executed instructions:/ { instrs = $3 }
+      /^Elapsed time:/ { seconds = $3 }
+      /^Instructions per second:/ { ips = $4 }
+      /^Peak RSS:/ { rss = $3 }
+      END {
+        mips = ips / 1e6
+        wall = wall_ns / 1e9
+        printf "%-12s %-9s %12d %9.1f %9.3f %9d\n", bench, engine, instrs, mips, wall, rss
+        printf "{\"rev\":\"%s\",\"time\":\"%s\",\"bench\":\"%s\",\"engine\":\"%s\",\"instrs\":%d,\"seconds\":%.6f,\"mips\":%.2f,\"wall_s\":%.6f,\"peak_rss_kib\":%d}\n", \
+          rev, stamp, bench, engine, instrs, seconds, mips, wall, rss >> results
+      }' "$report"
+  done
+done
+echo "Results appended to $RESULTS"
@@ -0,0 +1,55 @@
+# file: dma.s
+# The copies of memcpy.s done by the DMA device, then a fill that signals
+# completion with an interrupt.
+
+.global bench_start
+
+.section bench
+.equ dma_src, 0xFFFFFF20
+.equ dma_dst, 0xFFFFFF24
+.equ dma_len, 0xFFFFFF28
+.equ dma_ctrl, 0xFFFFFF2C
+bench_start:
+    ld $0xFFFFFEFE, %sp
+    ld $handler, %r1
+    csrwr %r1, %handler
+    ld $20000, %r6
+    ld $1, %r7
+    ld $1024, %r3
+    st %r3, dma_len
+    ld $1, %r4
+copy:
+    ld $src, %r1
+    st %r1, dma_src
+    ld $dst, %r2
+    st %r2, dma_dst
+    st %r4, dma_ctrl
+    sub %r7, %r6
+    bne %r6, %r0, copy
+    ld $0x5A, %r1
+    st %r1, dma_src
+    ld $6, %r4
+    st %r4, dma_ctrl
+wait:
+    ld dma_done, %r1
+    beq %r1, %r0, wait
+    ld dma_ctrl, %r5
+    ld dst, %r6
+    halt
+
+handler:
+    push %r1
+    ld $1, %r1
+    st %r1, dma_done
+    pop %r1
+    iret
+
+.section bench_data
+dma_done:
+.word 0
+src:
+.skip 1024
+dst:
+.skip 1024
+
+.end
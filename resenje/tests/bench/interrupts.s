@@ -0,0 +1,38 @@
+# file: interrupts.s
+# Software interrupt in a loop while the timer fires as well.
+
+.global bench_start
+
+.section bench
+.equ timer_config, 0xFFFFFF10
+bench_start:
+    ld $0xFFFFFEFE, %sp
+    ld $handler, %r1
+    csrwr %r1, %handler
+    ld $0, %r1
+    st %r1, timer_config
+    ld $3000000, %r1
+    ld $1, %r2
+loop:
+    int
+    sub %r2, %r1
+    bne %r1, %r0, loop
+    ld int_count, %r3
+    halt
+
+handler:
+    push %r1
+    push %r2
+    ld int_count, %r1
+    ld $1, %r2
+    add %r2, %r1
+    st %r1, int_count
+    pop %r2
+    pop %r1
+    iret
+
+.section bench_data
+int_count:
+.word 0
+
+.end
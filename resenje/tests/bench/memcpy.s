@@ -0,0 +1,33 @@
+# file: memcpy.s
+# Copies a 1 KiB buffer word by word, over and over.
+
+.global bench_start
+
+.section bench
+bench_start:
+    ld $0xFFFFFEFE, %sp
+    ld $20000, %r6
+    ld $1, %r7
+    ld $4, %r4
+outer:
+    ld $src, %r1
+    ld $dst, %r2
+    ld $256, %r3
+copy:
+    ld [%r1], %r5
+    st %r5, [%r2]
+    add %r4, %r1
+    add %r4, %r2
+    sub %r7, %r3
+    bne %r3, %r0, copy
+    sub %r7, %r6
+    bne %r6, %r0, outer
+    halt
+
+.section bench_data
+src:
+.skip 1024
+dst:
+.skip 1024
+
+.end
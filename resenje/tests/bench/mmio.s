@@ -0,0 +1,19 @@
+# file: mmio.s
+# Writes characters to the terminal output register.
+
+.global bench_start
+
+.section bench
+.equ term_out, 0xFFFFFF00
+bench_start:
+    ld $0xFFFFFEFE, %sp
+    ld $10000000, %r1
+    ld $1, %r2
+    ld $0x41, %r3
+loop:
+    st %r3, term_out
+    sub %r2, %r1
+    bne %r1, %r0, loop
+    halt
+
+.end
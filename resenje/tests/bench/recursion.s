@@ -0,0 +1,36 @@
+# file: recursion.s
+# Naive recursive fibonacci, heavy on call, ret, push and pop.
+
+.global bench_start
+
+.section bench
+bench_start:
+    ld $0xFFFFFEFE, %sp
+    ld $29, %r1
+    call fib
+    halt
+
+# r1 <= fib(r1)
+fib:
+    push %r2
+    push %r3
+    beq %r1, %r0, fib_done
+    ld $1, %r2
+    beq %r1, %r2, fib_done
+    sub %r2, %r1
+    push %r1
+    call fib
+    pop %r3
+    push %r1
+    ld $1, %r2
+    sub %r2, %r3
+    ld %r3, %r1
+    call fib
+    pop %r3
+    add %r3, %r1
+fib_done:
+    pop %r3
+    pop %r2
+    ret
+
+.end